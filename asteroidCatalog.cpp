@@ -0,0 +1,734 @@
+/**
+ * @file asteroidCatalog.cpp
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Orbital simulation asteroid catalog. Carga de asteroides reales
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Sobre el formato: se leen archivos de ancho fijo como MPCORB.DAT del Minor Planet Center. Si hay un
+ *      encabezado, termina en una línea de guiones; las líneas de menos de 103 columnas (vacías, separadores)
+ *      se ignoran. Columnas usadas (desde 1):
+ *           9 -  13  Magnitud absoluta H
+ *          21 -  25  Época, empaquetada (ej. K2218 = 2022-01-08)
+ *          27 -  35  Anomalía media en la época [grados]
+ *          38 -  46  Argumento del perihelio, J2000.0 [grados]
+ *          49 -  57  Longitud del nodo ascendente, J2000.0 [grados]
+ *          60 -  68  Inclinación respecto de la eclíptica, J2000.0 [grados]
+ *          71 -  79  Excentricidad
+ *          81 -  91  Movimiento medio diario [grados/día]
+ *          93 - 103  Semieje mayor [UA]
+ *
+ * Sobre rendimiento: el archivo se mapea en memoria y se divide en un trozo por hilo, alineado a líneas.
+ *      Una primera pasada cuenta los registros de cada trozo, para saber dónde escribe cada hilo, y la
+ *      segunda los convierte directamente sobre el bloque de asteroides. Los campos se leen en el lugar, sin
+ *      copiar líneas ni reservar memoria por registro. La ecuación de Kepler se resuelve por lotes de
+ *      KEPLER_BATCH registros, con un número fijo de iteraciones de Newton y sin ramas. Los lazos de Kepler
+ *      recorren siempre el lote completo (el resto se rellena con órbitas circulares) y calculan seno y
+ *      coseno con la serie de Taylor en lugar de llamar a libm, así que el compilador los vectoriza
+ *      (verificado con -O3 -fopt-info-vec en GCC, que es la configuración Release por defecto). Para eso
+ *      la anomalía media se lleva a [-180°, 180°] y la anomalía excéntrica se acota a ±KEPLER_ANOMALY_MAX,
+ *      donde la serie hasta el orden KEPLER_SERIES_ORDER tiene un error menor a 1E-9.
+ *
+ * Sobre la convergencia: el valor inicial M + e sin(M) hace diverger a Newton con e ≥ 0.995, que aparecen
+ *      en MPCORB.DAT. Se usa el de Danby, M + 0.85 e signo(M), con el que KEPLER_ITERATIONS iteraciones
+ *      dejan un residuo menor a 1E-10 rad en todo el rango de M hasta e = 0.9999.
+ *
+ * Sobre el marco de referencia: los elementos son heliocéntricos y eclípticos, mientras que ephemerides.h
+ *      es baricéntrico con la eclíptica en el plano x-z. Por eso se intercambian los ejes y y z, y se suma
+ *      la posición y velocidad del primer cuerpo de la simulación.
+ *
+ */
+
+#ifdef _WIN32
+// Evita los choques de nombres entre windows.h y raylib.h
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#define NOUSER
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "asteroidCatalog.h"
+
+#define GRAVITATIONAL_CONSTANT 6.6743E-11
+#define ASTRONOMICAL_UNIT 1.495978707E11 // [m]
+#define DEGREES_TO_RADIANS (3.14159265358979323846 / 180)
+
+#define CATALOG_RECORD_LENGTH 103
+#define CATALOG_HEADER_MAX 65536    // [bytes] donde se busca el fin del encabezado
+#define CATALOG_MIN_CHUNK (1 << 20) // [bytes] por hilo, para no lanzar hilos de más con archivos chicos
+
+#define KEPLER_BATCH 256
+#define KEPLER_ITERATIONS 12
+#define KEPLER_ANOMALY_MAX (3.14159265358979323846 + 1) // [rad] Cota de |E|, con |M| ≤ π y e < 1
+#define KEPLER_SERIES_ORDER 25
+
+// Albedo y densidad típicos, para estimar radio y masa a partir de H
+#define ASTEROIDS_ALBEDO 0.14
+#define ASTEROIDS_DENSITY 2000.0 // [kg/m^3]
+
+struct CatalogFile
+{
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+struct CatalogChunk
+{
+    const char *begin;
+    const char *end;
+    int recordNum;
+    int firstRecord;
+};
+
+// Lote de registros en formato SoA, para resolver Kepler
+struct KeplerBatch
+{
+    int num;
+    int firstRecord;
+    double meanAnomaly[KEPLER_BATCH];
+    double eccentricAnomaly[KEPLER_BATCH];
+    double eccentricity[KEPLER_BATCH];
+    double semimajorAxis[KEPLER_BATCH];
+    double perihelion[KEPLER_BATCH];
+    double node[KEPLER_BATCH];
+    double inclination[KEPLER_BATCH];
+    double magnitude[KEPLER_BATCH];
+};
+
+/**
+ * @brief Map a catalog file in memory, read only
+ *
+ * @param path
+ * @param file
+ * @return true on success
+ */
+static bool mapCatalogFile(const char *path, CatalogFile *file);
+
+/**
+ * @brief Unmap a catalog file
+ *
+ * @param file
+ */
+static void unmapCatalogFile(CatalogFile *file);
+
+/**
+ * @brief Get the first data line of a catalog, skipping the header if there is one
+ *
+ * @param data
+ * @param size
+ * @return const char*
+ */
+static const char *findCatalogData(const char *data, size_t size);
+
+/**
+ * @brief Parse a fixed width decimal field, without copying it
+ *
+ * @param field
+ * @param width
+ * @return double
+ */
+static double parseFixedField(const char *field, int width);
+
+/**
+ * @brief Get days from the simulation epoch (2022-01-01) to a packed MPC date
+ *
+ * @param packedDate Five characters, such as K2218
+ * @return double
+ */
+static double unpackEpoch(const char *packedDate);
+
+/**
+ * @brief Check whether a line is a valid bound orbit record
+ *
+ * @param line
+ * @param length Without line terminators
+ * @return true if valid
+ */
+static bool isCatalogRecord(const char *line, size_t length);
+
+/**
+ * @brief Count the records of a chunk
+ *
+ * @param chunk
+ */
+static void countCatalogRecords(CatalogChunk *chunk);
+
+/**
+ * @brief Convert the records of a chunk into asteroids
+ *
+ * @param chunk
+ * @param sim Simulation, with its bodies array already sized for the catalog
+ * @param pool Asteroid block
+ */
+static void parseCatalogRecords(CatalogChunk *chunk, OrbitalSim *sim, OrbitalBody *pool);
+
+/**
+ * @brief Solve Kepler's equation and store the state vectors of a batch
+ *
+ * @param batch
+ * @param sim
+ * @param pool
+ */
+static void convertKeplerBatch(KeplerBatch *batch, OrbitalSim *sim, OrbitalBody *pool);
+
+/**
+ * @brief Sine by its Taylor series up to KEPLER_SERIES_ORDER, without branches nor calls
+ *
+ * @param x [rad], accurate for |x| < 5
+ * @return double
+ */
+static inline double getKeplerSin(double x);
+
+/**
+ * @brief Cosine by its Taylor series up to KEPLER_SERIES_ORDER - 1, without branches nor calls
+ *
+ * @param x [rad], accurate for |x| < 5
+ * @return double
+ */
+static inline double getKeplerCos(double x);
+
+/**
+ * @brief Run a function over every chunk, one thread per chunk
+ *
+ * @param chunks
+ * @param chunkNum
+ * @param function
+ */
+template <typename Function>
+static void forEachCatalogChunk(CatalogChunk *chunks, int chunkNum, Function function);
+
+int loadAsteroidCatalog(OrbitalSim *sim, const char *path)
+{
+    int i;
+    CatalogFile file;
+
+    if (!mapCatalogFile(path, &file))
+        return -1;
+
+    const char *begin = findCatalogData(file.data, file.size);
+    const char *end = file.data + file.size;
+
+    int chunkNum = (int)std::thread::hardware_concurrency();
+    int chunkNumMax = (int)((end - begin) / CATALOG_MIN_CHUNK) + 1;
+
+    if (chunkNum < 1)
+        chunkNum = 1;
+    if (chunkNum > chunkNumMax)
+        chunkNum = chunkNumMax;
+
+    std::vector<CatalogChunk> chunks(chunkNum);
+
+    // Trozos de igual tamaño, extendidos hasta el siguiente fin de línea
+    for (i = 0; i < chunkNum; i++)
+    {
+        const char *chunkBegin = i ? chunks[i - 1].end : begin;
+        const char *chunkEnd = begin + (end - begin) * (i + 1) / chunkNum;
+
+        if (i == chunkNum - 1)
+            chunkEnd = end;
+        else if (chunkEnd <= chunkBegin)
+            chunkEnd = chunkBegin; // El trozo anterior ya lo cubrió
+        else
+        {
+            const char *newline = (const char *)memchr(chunkEnd, '\n', end - chunkEnd);
+            chunkEnd = newline ? newline + 1 : end;
+        }
+
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+    }
+
+    forEachCatalogChunk(chunks.data(), chunkNum, countCatalogRecords);
+
+    int asteroidNum = 0;
+
+    for (i = 0; i < chunkNum; i++)
+    {
+        chunks[i].firstRecord = asteroidNum;
+        asteroidNum += chunks[i].recordNum;
+    }
+
+    // Vacío, truncado o en otro formato: no se reemplazan los asteroides por ninguno
+    if (!asteroidNum)
+    {
+        unmapCatalogFile(&file);
+        return -1;
+    }
+
+    // Se reserva todo antes de tocar la simulación, para dejarla intacta si falla
+    OrbitalBody *pool = NULL;
+    OrbitalBody **bodies = NULL;
+
+    if (!(pool = (OrbitalBody *)malloc(asteroidNum * sizeof(OrbitalBody))) ||
+        !(bodies = (OrbitalBody **)malloc((sim->bodyNumCore + asteroidNum) * sizeof(OrbitalBody *))))
+    {
+        free(pool);
+        unmapCatalogFile(&file);
+        return -1;
+    }
+
+    memcpy(bodies, sim->bodies, sim->bodyNumCore * sizeof(OrbitalBody *));
+
+    if (!sim->asteroidPool)
+    {
+        for (i = sim->bodyNumCore; i < sim->bodyNum; i++)
+            free(sim->bodies[i]);
+    }
+
+    free(sim->asteroidPool);
+    free(sim->bodies);
+
+    sim->bodies = bodies;
+    sim->asteroidPool = pool;
+    sim->bodyNum = sim->bodyNumCore + asteroidNum;
+
+    forEachCatalogChunk(chunks.data(), chunkNum, [sim, pool](CatalogChunk *chunk)
+                        { parseCatalogRecords(chunk, sim, pool); });
+
+    unmapCatalogFile(&file);
+
+    return asteroidNum;
+}
+
+template <typename Function>
+static void forEachCatalogChunk(CatalogChunk *chunks, int chunkNum, Function function)
+{
+    int i;
+    std::vector<std::thread> threads;
+
+    // El último trozo lo procesa el hilo que llama
+    for (i = 0; i < chunkNum - 1; i++)
+        threads.emplace_back(function, &chunks[i]);
+
+    function(&chunks[chunkNum - 1]);
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+static void countCatalogRecords(CatalogChunk *chunk)
+{
+    const char *line = chunk->begin;
+
+    chunk->recordNum = 0;
+
+    while (line < chunk->end)
+    {
+        const char *newline = (const char *)memchr(line, '\n', chunk->end - line);
+        const char *lineEnd = newline ? newline : chunk->end;
+        size_t length = lineEnd - line;
+
+        if (length && line[length - 1] == '\r')
+            length--;
+
+        if (isCatalogRecord(line, length))
+            chunk->recordNum++;
+
+        line = lineEnd + 1;
+    }
+}
+
+static void parseCatalogRecords(CatalogChunk *chunk, OrbitalSim *sim, OrbitalBody *pool)
+{
+    KeplerBatch batch;
+    const char *line = chunk->begin;
+
+    batch.num = 0;
+    batch.firstRecord = chunk->firstRecord;
+
+    while (line < chunk->end)
+    {
+        const char *newline = (const char *)memchr(line, '\n', chunk->end - line);
+        const char *lineEnd = newline ? newline : chunk->end;
+        size_t length = lineEnd - line;
+
+        if (length && line[length - 1] == '\r')
+            length--;
+
+        if (isCatalogRecord(line, length))
+        {
+            int k = batch.num++;
+
+            // Anomalía media propagada desde la época del registro hasta la de la simulación
+            double meanAnomaly = parseFixedField(line + 26, 9) -
+                                 parseFixedField(line + 80, 11) * unpackEpoch(line + 20);
+            meanAnomaly = fmod(meanAnomaly, 360.0);
+            if (meanAnomaly > 180)
+                meanAnomaly -= 360;
+            else if (meanAnomaly < -180)
+                meanAnomaly += 360;
+
+            batch.meanAnomaly[k] = meanAnomaly * DEGREES_TO_RADIANS;
+            batch.perihelion[k] = parseFixedField(line + 37, 9) * DEGREES_TO_RADIANS;
+            batch.node[k] = parseFixedField(line + 48, 9) * DEGREES_TO_RADIANS;
+            batch.inclination[k] = parseFixedField(line + 59, 9) * DEGREES_TO_RADIANS;
+            batch.eccentricity[k] = parseFixedField(line + 70, 9);
+            batch.semimajorAxis[k] = parseFixedField(line + 92, 11) * ASTRONOMICAL_UNIT;
+            batch.magnitude[k] = parseFixedField(line + 8, 5);
+
+            if (batch.num == KEPLER_BATCH)
+            {
+                convertKeplerBatch(&batch, sim, pool);
+                batch.firstRecord += batch.num;
+                batch.num = 0;
+            }
+        }
+
+        line = lineEnd + 1;
+    }
+
+    if (batch.num)
+        convertKeplerBatch(&batch, sim, pool);
+}
+
+static void convertKeplerBatch(KeplerBatch *batch, OrbitalSim *sim, OrbitalBody *pool)
+{
+    int k, iteration;
+    int num = batch->num;
+
+    // Un lote incompleto se rellena para que los lazos tengan siempre KEPLER_BATCH vueltas
+    for (k = num; k < KEPLER_BATCH; k++)
+    {
+        batch->meanAnomaly[k] = 0;
+        batch->eccentricity[k] = 0;
+    }
+
+    // Newton-Raphson sobre E - e sin(E) = M, con un número fijo de iteraciones.
+    // Valor inicial de Danby, estable para e cercana a 1
+    for (k = 0; k < KEPLER_BATCH; k++)
+    {
+        double M = batch->meanAnomaly[k];
+
+        batch->eccentricAnomaly[k] = M + 0.85 * batch->eccentricity[k] * (M < 0 ? -1 : 1);
+    }
+
+    for (iteration = 0; iteration < KEPLER_ITERATIONS; iteration++)
+    {
+        for (k = 0; k < KEPLER_BATCH; k++)
+        {
+            double E = batch->eccentricAnomaly[k];
+            double e = batch->eccentricity[k];
+
+            E -= (E - e * getKeplerSin(E) - batch->meanAnomaly[k]) / (1 - e * getKeplerCos(E));
+
+            // Un paso que se pasa no saca a la serie de su rango
+            E = E < -KEPLER_ANOMALY_MAX ? -KEPLER_ANOMALY_MAX : E;
+            E = E > KEPLER_ANOMALY_MAX ? KEPLER_ANOMALY_MAX : E;
+
+            batch->eccentricAnomaly[k] = E;
+        }
+    }
+
+    double *eccentricAnomaly = batch->eccentricAnomaly;
+    double *eccentricity = batch->eccentricity;
+
+    OrbitalBody *center = sim->bodies[0];
+    double mu = GRAVITATIONAL_CONSTANT * center->mass;
+
+    for (k = 0; k < num; k++)
+    {
+        double a = batch->semimajorAxis[k];
+        double e = eccentricity[k];
+        double E = eccentricAnomaly[k];
+        double b = sqrt(1 - e * e);
+
+        // Posición y velocidad en el plano de la órbita, con x hacia el perihelio
+        double r = a * (1 - e * cos(E));
+        double x = a * (cos(E) - e);
+        double y = a * b * sin(E);
+        double vx = -sqrt(mu * a) / r * sin(E);
+        double vy = sqrt(mu * a) / r * b * cos(E);
+
+        double cosw = cos(batch->perihelion[k]), sinw = sin(batch->perihelion[k]);
+        double cosN = cos(batch->node[k]), sinN = sin(batch->node[k]);
+        double cosi = cos(batch->inclination[k]), sini = sin(batch->inclination[k]);
+
+        // Versores del perihelio (P) y a 90° en el plano de la órbita (Q), en la eclíptica
+        double Px = cosw * cosN - sinw * cosi * sinN;
+        double Py = cosw * sinN + sinw * cosi * cosN;
+        double Pz = sinw * sini;
+        double Qx = -sinw * cosN - cosw * cosi * sinN;
+        double Qy = -sinw * sinN + cosw * cosi * cosN;
+        double Qz = cosw * sini;
+
+        int index = batch->firstRecord + k;
+        OrbitalBody *body = &pool[index];
+
+        // Eclíptica (x, y, z) a la simulación (x, z, y)
+        body->position = {(float)(x * Px + y * Qx) + center->position.x,
+                          (float)(x * Pz + y * Qz) + center->position.y,
+                          (float)(x * Py + y * Qy) + center->position.z};
+        body->velocity = {(float)(vx * Px + vy * Qx) + center->velocity.x,
+                          (float)(vx * Pz + vy * Qz) + center->velocity.y,
+                          (float)(vx * Py + vy * Qy) + center->velocity.z};
+        body->acceleration = Vector3Zero();
+
+        // https://en.wikipedia.org/wiki/Absolute_magnitude#Solar_System_bodies_(H)
+        double radius = 1329E3 / sqrt(ASTEROIDS_ALBEDO) * pow(10, -batch->magnitude[k] / 5) / 2;
+
+        body->radius = (float)radius;
+        body->mass = (float)(ASTEROIDS_DENSITY * 4 / 3 * 3.14159265358979323846 * radius * radius * radius);
+
+        if (PARTY_TIME)
+        {
+            // rand() no es seguro entre hilos: el color sale de un hash del índice
+            unsigned hash = (unsigned)index * 2654435761U;
+            body->color = {(unsigned char)(hash >> 24), (unsigned char)(hash >> 16), (unsigned char)(hash >> 8), 126};
+        }
+
+        else
+            body->color = GRAY;
+
+        sim->bodies[sim->bodyNumCore + index] = body;
+    }
+}
+
+static inline double getKeplerSin(double x)
+{
+    int n;
+    double x2 = x * x;
+    double sum = 1;
+
+    // Horner: x (1 - x²/(2·3) (1 - x²/(4·5) (1 - ...)))
+    for (n = KEPLER_SERIES_ORDER; n > 1; n -= 2)
+        sum = 1 - x2 * (1.0 / (n * (n - 1))) * sum;
+
+    return x * sum;
+}
+
+static inline double getKeplerCos(double x)
+{
+    int n;
+    double x2 = x * x;
+    double sum = 1;
+
+    // Horner: 1 - x²/(1·2) (1 - x²/(3·4) (1 - ...))
+    for (n = KEPLER_SERIES_ORDER - 1; n > 1; n -= 2)
+        sum = 1 - x2 * (1.0 / (n * (n - 1))) * sum;
+
+    return sum;
+}
+
+static bool isCatalogRecord(const char *line, size_t length)
+{
+    if (length < CATALOG_RECORD_LENGTH)
+        return false;
+
+    double eccentricity = parseFixedField(line + 70, 9);
+    double semimajorAxis = parseFixedField(line + 92, 11);
+
+    // Sólo órbitas cerradas
+    return eccentricity >= 0 && eccentricity < 1 && semimajorAxis > 0;
+}
+
+static double parseFixedField(const char *field, int width)
+{
+    int i;
+    double value = 0;
+    double scale = 1;
+    bool negative = false;
+    bool fraction = false;
+
+    for (i = 0; i < width; i++)
+    {
+        char c = field[i];
+
+        if (c >= '0' && c <= '9')
+        {
+            value = value * 10 + (c - '0');
+            if (fraction)
+                scale *= 10;
+        }
+
+        else if (c == '.')
+            fraction = true;
+
+        else if (c == '-')
+            negative = true;
+    }
+
+    return (negative ? -value : value) / scale;
+}
+
+/**
+ * @brief Unpack a base-62 MPC digit
+ *
+ * @param c
+ * @return int
+ */
+static int unpackDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A' + 10;
+    return c - 'a' + 36;
+}
+
+/**
+ * @brief Get days since 1970-01-01 of a civil date
+ *
+ * https://howardhinnant.github.io/date_algorithms.html#days_from_civil
+ *
+ * @param year
+ * @param month
+ * @param day
+ * @return int
+ */
+static int daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + dayOfEra - 719468;
+}
+
+static double unpackEpoch(const char *packedDate)
+{
+    int year = unpackDigit(packedDate[0]) * 100 + unpackDigit(packedDate[1]) * 10 + unpackDigit(packedDate[2]);
+    int month = unpackDigit(packedDate[3]);
+    int day = unpackDigit(packedDate[4]);
+
+    // Época de ephemerides.h
+    return daysFromCivil(year, month, day) - daysFromCivil(2022, 1, 1);
+}
+
+static const char *findCatalogData(const char *data, size_t size)
+{
+    const char *line = data;
+    const char *end = data + (size < CATALOG_HEADER_MAX ? size : CATALOG_HEADER_MAX);
+
+    // El encabezado de MPCORB.DAT termina con una línea de guiones
+    while (line < end)
+    {
+        const char *newline = (const char *)memchr(line, '\n', end - line);
+
+        if (end - line >= 5 && !memcmp(line, "-----", 5))
+            return newline ? newline + 1 : data + size;
+
+        if (!newline)
+            break;
+
+        line = newline + 1;
+    }
+
+    // Sin encabezado
+    return data;
+}
+
+#ifdef _WIN32
+
+static bool mapCatalogFile(const char *path, CatalogFile *file)
+{
+    LARGE_INTEGER size;
+
+    *file = {NULL, 0, INVALID_HANDLE_VALUE, NULL};
+
+    file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    if (!GetFileSizeEx(file->file, &size))
+    {
+        CloseHandle(file->file);
+        return false;
+    }
+
+    file->size = (size_t)size.QuadPart;
+
+    // No se puede mapear un archivo vacío
+    if (!file->size)
+        return true;
+
+    if (!(file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL)) ||
+        !(file->data = (const char *)MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0)))
+    {
+        if (file->mapping)
+            CloseHandle(file->mapping);
+        CloseHandle(file->file);
+        return false;
+    }
+
+    return true;
+}
+
+static void unmapCatalogFile(CatalogFile *file)
+{
+    if (file->data)
+        UnmapViewOfFile(file->data);
+    if (file->mapping)
+        CloseHandle(file->mapping);
+    CloseHandle(file->file);
+}
+
+#else
+
+static bool mapCatalogFile(const char *path, CatalogFile *file)
+{
+    struct stat fileStat;
+    int fd;
+
+    *file = {NULL, 0};
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return false;
+
+    if (fstat(fd, &fileStat) < 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    file->size = (size_t)fileStat.st_size;
+
+    // No se puede mapear un archivo vacío
+    if (file->size)
+    {
+        void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+
+        madvise(data, file->size, MADV_SEQUENTIAL);
+        file->data = (const char *)data;
+    }
+
+    // El mapeo sigue siendo válido sin el descriptor
+    close(fd);
+
+    return true;
+}
+
+static void unmapCatalogFile(CatalogFile *file)
+{
+    if (file->data)
+        munmap((void *)file->data, file->size);
+}
+
+#endif
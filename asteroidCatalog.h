@@ -0,0 +1,24 @@
+/**
+ * @file asteroidCatalog.h
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Orbital simulation asteroid catalog. Carga de asteroides reales
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef ASTEROIDCATALOG_H
+#define ASTEROIDCATALOG_H
+
+#include "orbitalSim.h"
+
+// Loads the asteroids of an MPCORB-style orbital elements file into a simulation,
+// replacing its current asteroids. Elements are propagated to the simulation epoch
+// (2022-01-01) around the first body. Returns the number of asteroids loaded, or -1 on error
+// or if the file has no records, leaving the simulation intact.
+// Make any KeyframeCache after loading, since the number of bodies changes
+int loadAsteroidCatalog(OrbitalSim *sim, const char *path);
+
+#endif
@@ -0,0 +1,314 @@
+/**
+ * @file clusterSim.cpp
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Cluster simulation. Varios sistemas planetarios a la vez
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Sobre la simulación jerárquica: cada sistema es un OrbitalSim común en su propio marco local, con su
+ *      baricentro en reposo en el origen, así que las posiciones en float conservan la misma precisión que
+ *      en la simulación de un solo sistema. Los sistemas sólo interactúan entre sí a través de sus
+ *      baricentros, como masas puntuales, con un integrador externo en double que da un paso cada
+ *      CLUSTER_OUTER_STEP_RATIO pasos de los sistemas. Una aceleración externa es prácticamente uniforme
+ *      dentro de un sistema (las distancias entre estrellas son varios órdenes de magnitud mayores que el
+ *      tamaño de cada sistema), por lo que no cambia su movimiento local y no hace falta aplicarla.
+ *
+ *      El costo es O(sistemas × cuerpos por sistema) más O(sistemas²) para los baricentros, que es
+ *      despreciable con cientos de sistemas. Cada sistema es una tarea independiente, sin datos compartidos,
+ *      y el paso externo corre en paralelo con ellas ya que sólo toca los baricentros.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "clusterSim.h"
+
+#define GRAVITATIONAL_CONSTANT 6.6743E-11
+#define SOLAR_MASS 1988500E24F
+#define SOLAR_RADIUS 695700E3F
+
+#define CLUSTER_RADIUS 3E15              // [m], unos 0.1 pc
+#define CLUSTER_VELOCITY_DISPERSION 2E3 // [m/s]
+#define CLUSTER_PLANETS_MAX 3
+
+/**
+ * @brief Get a random float between min and max
+ *
+ * @param min
+ * @param max
+ * @return float
+ */
+static float getClusterRandom(float min, float max);
+
+/**
+ * @brief Make a synthetic star system: a star, some planets in circular orbits and a belt
+ *
+ * @param timeStep
+ * @param asteroidNum
+ * @return OrbitalSim*
+ */
+static OrbitalSim *makeClusterSystem(float timeStep, int asteroidNum);
+
+/**
+ * @brief Move a system to its barycentric frame and get its total mass
+ *
+ * @param system
+ * @return double
+ */
+static double centerClusterSystem(OrbitalSim *system);
+
+/**
+ * @brief Task: step one system
+ *
+ * @param data Cluster
+ * @param system
+ */
+static void runClusterSystem(void *data, int system);
+
+/**
+ * @brief Task: step the barycentres, once every CLUSTER_OUTER_STEP_RATIO calls
+ *
+ * @param data Cluster
+ * @param index Unused
+ */
+static void runClusterOuter(void *data, int index);
+
+ClusterSim *makeClusterSim(float timeStep, int systemNum, int asteroidNum)
+{
+    int i;
+    ClusterSim *cluster = NULL;
+
+    if (!(cluster = (ClusterSim *)malloc(sizeof(ClusterSim))))
+        return NULL;
+
+    *cluster = {timeStep,
+                0,
+                systemNum,
+                (OrbitalSim **)calloc(systemNum, sizeof(OrbitalSim *)),
+                (ClusterVector *)malloc(systemNum * sizeof(ClusterVector)),
+                (ClusterVector *)malloc(systemNum * sizeof(ClusterVector)),
+                (double *)malloc(systemNum * sizeof(double)),
+                0,
+                0,
+                makeTaskGraph()};
+
+    if (!cluster->systems || !cluster->positions || !cluster->velocities || !cluster->masses ||
+        !cluster->graph || addTask(cluster->graph, runClusterOuter, cluster, 0) < 0)
+    {
+        freeClusterSim(cluster);
+        return NULL;
+    }
+
+    ClusterVector momentum = {0, 0, 0};
+    double totalMass = 0;
+
+    for (i = 0; i < systemNum; i++)
+    {
+        if (!(cluster->systems[i] = makeClusterSystem(timeStep, asteroidNum)) ||
+            addTask(cluster->graph, runClusterSystem, cluster, i) < 0)
+        {
+            freeClusterSim(cluster);
+            return NULL;
+        }
+
+        cluster->masses[i] = centerClusterSystem(cluster->systems[i]);
+
+        // Posición uniforme en una esfera, y velocidad con dirección al azar
+        ClusterVector position;
+        do
+        {
+            position = {getClusterRandom(-1, 1), getClusterRandom(-1, 1), getClusterRandom(-1, 1)};
+        } while (position.x * position.x + position.y * position.y + position.z * position.z > 1);
+
+        cluster->positions[i] = {position.x * CLUSTER_RADIUS, position.y * CLUSTER_RADIUS, position.z * CLUSTER_RADIUS};
+        cluster->velocities[i] = {getClusterRandom(-1, 1) * CLUSTER_VELOCITY_DISPERSION,
+                                  getClusterRandom(-1, 1) * CLUSTER_VELOCITY_DISPERSION,
+                                  getClusterRandom(-1, 1) * CLUSTER_VELOCITY_DISPERSION};
+
+        momentum.x += cluster->masses[i] * cluster->velocities[i].x;
+        momentum.y += cluster->masses[i] * cluster->velocities[i].y;
+        momentum.z += cluster->masses[i] * cluster->velocities[i].z;
+        totalMass += cluster->masses[i];
+    }
+
+    // Sin deriva del cúmulo completo
+    for (i = 0; i < systemNum; i++)
+    {
+        cluster->velocities[i].x -= momentum.x / totalMass;
+        cluster->velocities[i].y -= momentum.y / totalMass;
+        cluster->velocities[i].z -= momentum.z / totalMass;
+    }
+
+    return cluster;
+}
+
+void updateClusterSim(ClusterSim *cluster, TaskScheduler *scheduler)
+{
+    if (runTaskGraph(scheduler, cluster->graph))
+        cluster->time += cluster->timeStep;
+}
+
+ClusterVector getClusterBodyPosition(ClusterSim *cluster, int system, int body)
+{
+    Vector3 local = cluster->systems[system]->bodies[body]->position;
+    ClusterVector barycentre = cluster->positions[system];
+    ClusterVector velocity = cluster->velocities[system];
+
+    // El baricentro sólo avanza cada CLUSTER_OUTER_STEP_RATIO pasos: se extrapola hasta el tiempo actual
+    double elapsed = cluster->outerTimeStep;
+
+    return {barycentre.x + velocity.x * elapsed + local.x,
+            barycentre.y + velocity.y * elapsed + local.y,
+            barycentre.z + velocity.z * elapsed + local.z};
+}
+
+void freeClusterSim(ClusterSim *cluster)
+{
+    int i;
+
+    if (cluster->systems)
+    {
+        for (i = 0; i < cluster->systemNum; i++)
+        {
+            if (cluster->systems[i])
+                freeOrbitalSim(cluster->systems[i]);
+        }
+    }
+
+    if (cluster->graph)
+        freeTaskGraph(cluster->graph);
+
+    free(cluster->systems);
+    free(cluster->positions);
+    free(cluster->velocities);
+    free(cluster->masses);
+    free(cluster);
+}
+
+static void runClusterSystem(void *data, int system)
+{
+    ClusterSim *cluster = (ClusterSim *)data;
+    OrbitalSim *sim = cluster->systems[system];
+
+    sim->timeStep = cluster->timeStep;
+    updateOrbitalSim(sim);
+}
+
+static void runClusterOuter(void *data, int /* index */)
+{
+    int i, j;
+    ClusterSim *cluster = (ClusterSim *)data;
+
+    cluster->outerTimeStep += cluster->timeStep;
+
+    if (++cluster->innerStepNum < CLUSTER_OUTER_STEP_RATIO)
+        return;
+
+    double timeStep = cluster->outerTimeStep;
+    cluster->outerTimeStep = 0;
+    cluster->innerStepNum = 0;
+
+    // Mismo esquema que updateOrbitalSim: fuerzas iguales y opuestas, y luego velocidad y posición
+    for (i = 0; i < cluster->systemNum; i++)
+    {
+        for (j = i + 1; j < cluster->systemNum; j++)
+        {
+            double dx = cluster->positions[i].x - cluster->positions[j].x;
+            double dy = cluster->positions[i].y - cluster->positions[j].y;
+            double dz = cluster->positions[i].z - cluster->positions[j].z;
+            double distance = sqrt(dx * dx + dy * dy + dz * dz);
+            double factor = -GRAVITATIONAL_CONSTANT * timeStep / (distance * distance * distance);
+
+            cluster->velocities[i].x += factor * cluster->masses[j] * dx;
+            cluster->velocities[i].y += factor * cluster->masses[j] * dy;
+            cluster->velocities[i].z += factor * cluster->masses[j] * dz;
+
+            cluster->velocities[j].x -= factor * cluster->masses[i] * dx;
+            cluster->velocities[j].y -= factor * cluster->masses[i] * dy;
+            cluster->velocities[j].z -= factor * cluster->masses[i] * dz;
+        }
+    }
+
+    for (i = 0; i < cluster->systemNum; i++)
+    {
+        cluster->positions[i].x += cluster->velocities[i].x * timeStep;
+        cluster->positions[i].y += cluster->velocities[i].y * timeStep;
+        cluster->positions[i].z += cluster->velocities[i].z * timeStep;
+    }
+}
+
+static OrbitalSim *makeClusterSystem(float timeStep, int asteroidNum)
+{
+    int i;
+    OrbitalBody coreBodies[CLUSTER_PLANETS_MAX + 1];
+    int planetNum = rand() % (CLUSTER_PLANETS_MAX + 1);
+
+    float starMass = getClusterRandom(0.3F, 2.0F);
+    const Color starColors[] = {RED, ORANGE, GOLD, YELLOW, WHITE};
+
+    coreBodies[0] = {Vector3Zero(),
+                     Vector3Zero(),
+                     Vector3Zero(),
+                     starMass * SOLAR_MASS,
+                     SOLAR_RADIUS * powf(starMass, 0.8F),
+                     starColors[(int)((starMass - 0.3F) / 1.7F * 4.99F)]};
+
+    const Color planetColors[] = {GRAY, BEIGE, BLUE, SKYBLUE, DARKBLUE};
+
+    for (i = 1; i <= planetNum; i++)
+    {
+        // Órbitas circulares en el plano x-z, como en placeAsteroid
+        float r = getClusterRandom(5E10F, 8E11F);
+        float phi = getClusterRandom(0, 2 * 3.14F);
+        float v = sqrtf((float)GRAVITATIONAL_CONSTANT * coreBodies[0].mass / r);
+
+        coreBodies[i] = {{r * cosf(phi), 0, r * sinf(phi)},
+                         {-v * sinf(phi), 0, v * cosf(phi)},
+                         Vector3Zero(),
+                         getClusterRandom(1E24F, 2E27F),
+                         getClusterRandom(3E6F, 7E7F),
+                         planetColors[rand() % 5]};
+    }
+
+    return makeOrbitalSimSystem(timeStep, coreBodies, planetNum + 1, asteroidNum);
+}
+
+static double centerClusterSystem(OrbitalSim *system)
+{
+    int i;
+    double mass = 0;
+    ClusterVector position = {0, 0, 0};
+    ClusterVector momentum = {0, 0, 0};
+
+    for (i = 0; i < system->bodyNum; i++)
+    {
+        OrbitalBody *body = system->bodies[i];
+
+        mass += body->mass;
+        position.x += (double)body->mass * body->position.x;
+        position.y += (double)body->mass * body->position.y;
+        position.z += (double)body->mass * body->position.z;
+        momentum.x += (double)body->mass * body->velocity.x;
+        momentum.y += (double)body->mass * body->velocity.y;
+        momentum.z += (double)body->mass * body->velocity.z;
+    }
+
+    Vector3 barycentre = {(float)(position.x / mass), (float)(position.y / mass), (float)(position.z / mass)};
+    Vector3 velocity = {(float)(momentum.x / mass), (float)(momentum.y / mass), (float)(momentum.z / mass)};
+
+    for (i = 0; i < system->bodyNum; i++)
+    {
+        system->bodies[i]->position = Vector3Subtract(system->bodies[i]->position, barycentre);
+        system->bodies[i]->velocity = Vector3Subtract(system->bodies[i]->velocity, velocity);
+    }
+
+    return mass;
+}
+
+static float getClusterRandom(float min, float max)
+{
+    return min + (max - min) * rand() / (float)RAND_MAX;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file clusterSim.h
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Cluster simulation. Varios sistemas planetarios a la vez
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef CLUSTERSIM_H
+#define CLUSTERSIM_H
+
+#include "orbitalSim.h"
+#include "taskScheduler.h"
+
+// Pasos de cada sistema por cada paso del integrador externo
+#define CLUSTER_OUTER_STEP_RATIO 10
+
+// Las distancias entre sistemas no entran con precisión en un float
+struct ClusterVector
+{
+    double x;
+    double y;
+    double z;
+};
+
+struct ClusterSim
+{
+    float timeStep;
+    double time;
+    int systemNum;
+    OrbitalSim **systems;      // Cada uno en su marco local, con el baricentro en el origen
+    ClusterVector *positions;  // Baricentro de cada sistema [m]
+    ClusterVector *velocities; // [m/s]
+    double *masses;            // Masa total de cada sistema [kg]
+    double outerTimeStep;      // Tiempo acumulado desde el último paso externo [s]
+    int innerStepNum;          // Pasos de los sistemas desde el último paso externo
+    TaskGraph *graph;
+};
+
+// Makes a synthetic cluster of systemNum star systems, each with asteroidNum asteroids
+ClusterSim *makeClusterSim(float timeStep, int systemNum, int asteroidNum);
+
+// Updates a given cluster, running every system in parallel on a scheduler
+void updateClusterSim(ClusterSim *cluster, TaskScheduler *scheduler);
+
+// Position of a system body in the cluster frame, at the current time
+ClusterVector getClusterBodyPosition(ClusterSim *cluster, int system, int body);
+
+// Destroys a given cluster
+void freeClusterSim(ClusterSim *cluster);
+
+#endif
@@ -0,0 +1,402 @@
+/**
+ * @file keyframeCache.cpp
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Orbital simulation keyframes. Retroceso y salto temporal
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Sobre el formato de los keyframes: de cada cuerpo sólo se guarda position y velocity. La masa, el radio
+ *      y el color no cambian durante la simulación, y la aceleración se recalcula desde cero en cada
+ *      updateOrbitalSim, por lo que un keyframe ocupa la mitad que una copia de los OrbitalBody. No se
+ *      cuantizan los datos: el estado restaurado tiene que ser idéntico bit a bit para que volver a simular
+ *      desde un keyframe dé siempre el mismo resultado.
+ *
+ *      Los keyframes no se comprimen. Se probó XOR contra un keyframe de referencia, separando los bytes por
+ *      plano y codificando las corridas de ceros: contra el primer keyframe no se gana nada (en 30 días los
+ *      asteroides ya cambiaron de mantisa y de signo), y contra el keyframe anterior se ahorra apenas un
+ *      12%, a cambio de que cada keyframe dependa del anterior. Eso choca con el raleo, que descarta
+ *      keyframes intermedios, y con el seek, que tendría que decodificar toda la cadena.
+ *
+ * Sobre el determinismo: cada keyframe guarda el timeStep con el que se venía simulando, y el seek vuelve a
+ *      simular con ese paso, así que llegar a un tiempo ya simulado da el mismo estado si el paso no cambió
+ *      entre el keyframe y ese tiempo. Después de un seek, los keyframes posteriores pertenecen a la corrida
+ *      abandonada: se descartan en cuanto la simulación vuelve a avanzar, para no mezclar trayectorias.
+ *
+ * Sobre el raleo: cuando se llena el presupuesto de memoria, se descarta el keyframe cuyo hueco con sus
+ *      vecinos es más chico en proporción a su antigüedad. Así los keyframes recientes quedan densos y los
+ *      viejos se espacian de forma geométrica. El primer keyframe nunca se descarta, para poder volver a
+ *      cualquier instante, ni tampoco los últimos usados por un seek (LRU), ya que suelen volver a pedirse.
+ *
+ * Sobre la captura en el grafo de paso: beginKeyframeCapture decide antes del paso si el estado al que se
+ *      llega inicia un intervalo nuevo, y reserva el keyframe. captureKeyframeBlock copia cada bloque de
+ *      asteroides apenas se integra, en paralelo con el resto del paso, y endKeyframeCapture sólo agrega
+ *      los cuerpos principales, que se integran al final.
+ *
+ */
+
+#include "keyframeCache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SECONDS_PER_DAY 86400.0F
+
+/**
+ * @brief Get the size of the state of one keyframe, in Vector3 units
+ *
+ * @param sim
+ * @return int
+ */
+static int getKeyframeStateNum(OrbitalSim *sim);
+
+/**
+ * @brief Copy the state of the bodies [first, last) into a keyframe state
+ *
+ * @param sim
+ * @param state
+ * @param first
+ * @param last
+ */
+static void storeKeyframeState(OrbitalSim *sim, Vector3 *state, int first, int last);
+
+/**
+ * @brief Copy a keyframe state into the simulation
+ *
+ * @param sim
+ * @param keyframe
+ */
+static void restoreKeyframe(OrbitalSim *sim, Keyframe *keyframe);
+
+/**
+ * @brief Drop the keyframes left after a seek, once the simulation moves forward
+ *
+ * @param cache
+ */
+static void dropAbandonedKeyframes(KeyframeCache *cache);
+
+/**
+ * @brief Get a state buffer for a keyframe at time, evicting one if the cache is full
+ *
+ * @param cache
+ * @param time
+ * @param slot Interval of the new keyframe
+ * @return Vector3* NULL if that interval already has a keyframe, or out of memory
+ */
+static Vector3 *reserveKeyframe(KeyframeCache *cache, float time, int *slot);
+
+/**
+ * @brief Insert a filled state as the keyframe of the current simulation time
+ *
+ * @param cache
+ * @param state
+ * @param slot
+ */
+static void insertKeyframe(KeyframeCache *cache, Vector3 *state, int slot);
+
+/**
+ * @brief Remove the keyframe that contributes less to seek latency and return its state buffer
+ *
+ * @param cache
+ * @return Vector3*
+ */
+static Vector3 *evictKeyframe(KeyframeCache *cache);
+
+/**
+ * @brief Simulate one replay step, on the step graph if there is one
+ *
+ * @param sim
+ * @param step
+ * @param scheduler
+ */
+static void replayKeyframeStep(OrbitalSim *sim, StepGraph *step, TaskScheduler *scheduler);
+
+KeyframeCache *makeKeyframeCache(OrbitalSim *sim, float intervalDays, size_t memoryBudget)
+{
+    KeyframeCache *cache = NULL;
+    Keyframe *keyframes = NULL;
+    Vector3 *state = NULL;
+
+    size_t keyframeSize = getKeyframeStateNum(sim) * sizeof(Vector3);
+    int keyframeMax = (int)(memoryBudget / keyframeSize);
+
+    // Con menos de dos no hay raleo posible
+    if (keyframeMax < 2)
+        keyframeMax = 2;
+
+    if (!(cache = (KeyframeCache *)malloc(sizeof(KeyframeCache))))
+        return NULL;
+
+    if (!(keyframes = (Keyframe *)malloc(keyframeMax * sizeof(Keyframe))))
+    {
+        free(cache);
+        return NULL;
+    }
+
+    *cache = {sim, intervalDays * SECONDS_PER_DAY, memoryBudget, keyframeMax, 0, keyframes, 0, 0, false, 0, NULL, 0, 0};
+
+    if (!(state = (Vector3 *)malloc(keyframeSize)))
+    {
+        free(keyframes);
+        free(cache);
+        return NULL;
+    }
+
+    storeKeyframeState(sim, state, 0, sim->bodyNum);
+    insertKeyframe(cache, state, (int)(sim->time / cache->interval));
+
+    return cache;
+}
+
+void updateKeyframeCache(KeyframeCache *cache)
+{
+    int slot;
+    OrbitalSim *sim = cache->sim;
+    Vector3 *state;
+
+    dropAbandonedKeyframes(cache);
+
+    if (!(state = reserveKeyframe(cache, sim->time, &slot)))
+        return;
+
+    storeKeyframeState(sim, state, 0, sim->bodyNum);
+    insertKeyframe(cache, state, slot);
+}
+
+void beginKeyframeCapture(KeyframeCache *cache)
+{
+    OrbitalSim *sim = cache->sim;
+
+    dropAbandonedKeyframes(cache);
+
+    // El mismo tiempo al que llega integrateOrbitalSimCore
+    cache->captureTime = sim->time + sim->timeStep;
+    cache->captureState = reserveKeyframe(cache, cache->captureTime, &cache->captureSlot);
+}
+
+void captureKeyframeBlock(OrbitalSim *sim, int block, void *data)
+{
+    int first, last;
+    KeyframeCache *cache = (KeyframeCache *)data;
+
+    if (!cache->captureState)
+        return;
+
+    getOrbitalSimBlockRange(sim, block, &first, &last);
+    storeKeyframeState(sim, cache->captureState, first, last);
+}
+
+void endKeyframeCapture(KeyframeCache *cache)
+{
+    OrbitalSim *sim = cache->sim;
+    Vector3 *state = cache->captureState;
+
+    if (!state)
+        return;
+
+    cache->captureState = NULL;
+
+    // El paso no llegó a darse (por ejemplo, sin memoria para el grafo)
+    if (sim->time != cache->captureTime)
+    {
+        free(state);
+        return;
+    }
+
+    storeKeyframeState(sim, state, 0, sim->bodyNumCore);
+    insertKeyframe(cache, state, cache->captureSlot);
+}
+
+bool seekOrbitalSim(KeyframeCache *cache, float time, StepGraph *step, TaskScheduler *scheduler)
+{
+    int i;
+    OrbitalSim *sim = cache->sim;
+    float timeStep = sim->timeStep;
+
+    if (timeStep <= 0)
+        return false;
+
+    for (i = cache->keyframeNum - 1; i >= 0 && cache->keyframes[i].time > time; i--)
+        ;
+
+    if (i < 0)
+        return false;
+
+    // Si se avanza y el estado actual está más cerca que el keyframe, se sigue desde ahí
+    if (sim->time > time || sim->time < cache->keyframes[i].time)
+    {
+        restoreKeyframe(sim, &cache->keyframes[i]);
+        cache->keyframes[i].lastUsed = ++cache->useClock;
+    }
+
+    // Un keyframe capturado en pausa no sirve para volver a simular
+    if (sim->timeStep <= 0)
+        sim->timeStep = timeStep;
+
+    float replayStep = sim->timeStep;
+
+    while (sim->time + replayStep <= time)
+        replayKeyframeStep(sim, step, scheduler);
+
+    // Último paso parcial para caer justo en el tiempo pedido
+    if (sim->time < time)
+    {
+        sim->timeStep = time - sim->time;
+        replayKeyframeStep(sim, step, scheduler);
+    }
+
+    sim->timeStep = timeStep;
+    cache->seekPending = true;
+    cache->seekTime = sim->time;
+
+    return true;
+}
+
+void freeKeyframeCache(KeyframeCache *cache)
+{
+    int i;
+
+    for (i = 0; i < cache->keyframeNum; i++)
+        free(cache->keyframes[i].state);
+
+    free(cache->captureState);
+    free(cache->keyframes);
+    free(cache);
+}
+
+static int getKeyframeStateNum(OrbitalSim *sim)
+{
+    return 2 * sim->bodyNum;
+}
+
+static void storeKeyframeState(OrbitalSim *sim, Vector3 *state, int first, int last)
+{
+    int i;
+
+    for (i = first; i < last; i++)
+    {
+        state[2 * i] = sim->bodies[i]->position;
+        state[2 * i + 1] = sim->bodies[i]->velocity;
+    }
+}
+
+static void restoreKeyframe(OrbitalSim *sim, Keyframe *keyframe)
+{
+    int i;
+
+    sim->time = keyframe->time;
+    sim->timeStep = keyframe->timeStep;
+
+    for (i = 0; i < sim->bodyNum; i++)
+    {
+        sim->bodies[i]->position = keyframe->state[2 * i];
+        sim->bodies[i]->velocity = keyframe->state[2 * i + 1];
+    }
+}
+
+static void dropAbandonedKeyframes(KeyframeCache *cache)
+{
+    if (!cache->seekPending)
+        return;
+
+    // Lo que quedó después del seek ya no es la trayectoria que se está simulando
+    while (cache->keyframeNum > 1 && cache->keyframes[cache->keyframeNum - 1].time > cache->seekTime)
+        free(cache->keyframes[--cache->keyframeNum].state);
+
+    cache->seekPending = false;
+}
+
+static Vector3 *reserveKeyframe(KeyframeCache *cache, float time, int *slot)
+{
+    int i;
+
+    *slot = (int)(time / cache->interval);
+
+    // Posición en la que quedaría el nuevo keyframe, ordenado por tiempo
+    for (i = cache->keyframeNum; i > 0 && cache->keyframes[i - 1].time > time; i--)
+        ;
+
+    // Ya hay un keyframe para este intervalo
+    if ((i > 0 && cache->keyframes[i - 1].slot == *slot) ||
+        (i < cache->keyframeNum && cache->keyframes[i].slot == *slot))
+        return NULL;
+
+    if (cache->keyframeNum == cache->keyframeMax)
+        return evictKeyframe(cache);
+
+    // Sin memoria: se sigue sin este keyframe
+    return (Vector3 *)malloc(getKeyframeStateNum(cache->sim) * sizeof(Vector3));
+}
+
+static void insertKeyframe(KeyframeCache *cache, Vector3 *state, int slot)
+{
+    int i;
+    OrbitalSim *sim = cache->sim;
+
+    for (i = cache->keyframeNum; i > 0 && cache->keyframes[i - 1].time > sim->time; i--)
+        ;
+
+    memmove(&cache->keyframes[i + 1],
+            &cache->keyframes[i],
+            (cache->keyframeNum - i) * sizeof(Keyframe));
+    cache->keyframeNum++;
+
+    cache->keyframes[i] = {sim->time, sim->timeStep, slot, 0, state};
+}
+
+static Vector3 *evictKeyframe(KeyframeCache *cache)
+{
+    int i;
+    int evicted = -1;
+    bool protect = true;
+    float now = cache->sim->time;
+    Keyframe *keyframes = cache->keyframes;
+    int last = cache->keyframeNum - 1;
+
+    // Si todos los candidatos están protegidos por LRU, se ignora la protección
+    while (evicted < 0)
+    {
+        float minScore = 0;
+
+        // El primero (índice 0) nunca se descarta
+        for (i = 1; i <= last; i++)
+        {
+            if (protect && keyframes[i].lastUsed &&
+                cache->useClock - keyframes[i].lastUsed < KEYFRAME_LRU_PROTECTED)
+                continue;
+
+            float next = (i < last) ? keyframes[i + 1].time : now;
+            float age = now - keyframes[i].time;
+            float score = (next - keyframes[i - 1].time) / (age > 0 ? age : cache->interval);
+
+            if (evicted < 0 || score < minScore)
+            {
+                evicted = i;
+                minScore = score;
+            }
+        }
+
+        if (!protect && evicted < 0)
+            evicted = last;
+
+        protect = false;
+    }
+
+    Vector3 *state = keyframes[evicted].state;
+
+    memmove(&keyframes[evicted],
+            &keyframes[evicted + 1],
+            (last - evicted) * sizeof(Keyframe));
+    cache->keyframeNum--;
+    cache->evictedNum++;
+
+    return state;
+}
+
+static void replayKeyframeStep(OrbitalSim *sim, StepGraph *step, TaskScheduler *scheduler)
+{
+    if (step)
+        updateOrbitalSimGraph(step, scheduler);
+    else
+        updateOrbitalSim(sim);
+}
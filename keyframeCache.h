@@ -0,0 +1,74 @@
+/**
+ * @file keyframeCache.h
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Orbital simulation keyframes. Retroceso y salto temporal
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef KEYFRAMECACHE_H
+#define KEYFRAMECACHE_H
+
+#include <stddef.h>
+
+#include "orbitalSim.h"
+#include "stepGraph.h"
+
+// Keyframes recientemente usados por un seek que no se descartan al ralear
+#define KEYFRAME_LRU_PROTECTED 4
+
+struct Keyframe
+{
+    float time;
+    float timeStep;     // Paso con el que se venía simulando, para volver a simular igual
+    int slot;           // Múltiplo del intervalo de captura al que pertenece
+    unsigned lastUsed;  // Reloj de uso, para LRU
+    Vector3 *state;     // position y velocity de cada cuerpo, intercalados
+};
+
+struct KeyframeCache
+{
+    OrbitalSim *sim;
+    float interval;      // [s]
+    size_t memoryBudget; // [bytes]
+    int keyframeMax;
+    int keyframeNum;
+    Keyframe *keyframes; // Ordenados por tiempo
+    unsigned useClock;
+    int evictedNum;      // Keyframes descartados por el raleo
+    bool seekPending;    // Hubo un seek y la simulación todavía no volvió a avanzar
+    float seekTime;
+
+    // Keyframe que se está capturando durante un paso del grafo, o NULL
+    Vector3 *captureState;
+    int captureSlot;
+    float captureTime;
+};
+
+// Makes a keyframe cache for a simulation, capturing every intervalDays simulated days
+// without exceeding memoryBudget bytes of keyframe state. Captures the current state.
+KeyframeCache *makeKeyframeCache(OrbitalSim *sim, float intervalDays, size_t memoryBudget);
+
+// Captures a keyframe if the simulation crossed a new interval, dropping the keyframes of a run
+// abandoned by a seek. Call after updateOrbitalSim
+void updateKeyframeCache(KeyframeCache *cache);
+
+// Same as updateKeyframeCache, but captured while a step graph runs: call beginKeyframeCapture
+// before updateOrbitalSimGraph and endKeyframeCapture after it, with captureKeyframeBlock (data
+// being the cache) as the step graph hook
+void beginKeyframeCapture(KeyframeCache *cache);
+void captureKeyframeBlock(OrbitalSim *sim, int block, void *data);
+void endKeyframeCapture(KeyframeCache *cache);
+
+// Restores the simulation to time, from the nearest earlier keyframe, re-simulating with the
+// timeStep that keyframe was captured with, on step if it is not NULL.
+// Returns false if there is no keyframe before time
+bool seekOrbitalSim(KeyframeCache *cache, float time, StepGraph *step, TaskScheduler *scheduler);
+
+// Destroys a given keyframe cache
+void freeKeyframeCache(KeyframeCache *cache);
+
+#endif
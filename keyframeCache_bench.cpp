@@ -0,0 +1,88 @@
+/*
+ * Orbital simulation
+ *
+ * 22.08 EDA
+ * Copyright (C) 2022 Marc S. Ressl
+ *
+ * Benchmark: latencia de seekOrbitalSim, capturando y volviendo a simular en el grafo de paso como main
+ */
+
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+
+#include "orbitalSim.h"
+#include "keyframeCache.h"
+#include "stepGraph.h"
+
+#define SECONDS_PER_DAY 86400.0F
+
+#define BENCH_YEARS 10
+#define BENCH_SEEKS 50
+#define BENCH_KEYFRAME_INTERVAL_DAYS 30
+#define BENCH_MEMORY_BUDGET (64 << 20)
+
+using namespace std;
+using namespace std::chrono;
+
+int main()
+{
+    float fps = 60.0F;
+    float timeMultiplier = 100 * SECONDS_PER_DAY;
+    float timeStep = timeMultiplier / fps;
+
+    OrbitalSim *sim = makeOrbitalSim(timeStep);
+    KeyframeCache *cache = sim ? makeKeyframeCache(sim, BENCH_KEYFRAME_INTERVAL_DAYS, BENCH_MEMORY_BUDGET) : NULL;
+    TaskScheduler *scheduler = makeTaskScheduler(0);
+    StepGraph *step = cache && scheduler ? makeStepGraph(sim, scheduler, captureKeyframeBlock, cache) : NULL;
+
+    if (!step)
+    {
+        cout << "No se pudo inicializar el benchmark" << endl;
+        return 1;
+    }
+
+    auto start = steady_clock::now();
+
+    while (sim->time < BENCH_YEARS * 365 * SECONDS_PER_DAY)
+    {
+        beginKeyframeCapture(cache);
+        updateOrbitalSimGraph(step, scheduler);
+        endKeyframeCapture(cache);
+    }
+
+    double forwardSeconds = duration<double>(steady_clock::now() - start).count();
+    float endTime = sim->time;
+
+    cout << "Simulated " << BENCH_YEARS << " years in " << forwardSeconds << " s, "
+         << cache->keyframeNum << "/" << cache->keyframeMax << " keyframes, "
+         << getTaskSchedulerThreadNum(scheduler) << " threads" << endl;
+
+    double totalSeconds = 0;
+    double maxSeconds = 0;
+
+    srand(1);
+
+    for (int i = 0; i < BENCH_SEEKS; i++)
+    {
+        float time = endTime * rand() / (float)RAND_MAX;
+
+        auto seekStart = steady_clock::now();
+        seekOrbitalSim(cache, time, step, scheduler);
+        double seekSeconds = duration<double>(steady_clock::now() - seekStart).count();
+
+        totalSeconds += seekSeconds;
+        if (seekSeconds > maxSeconds)
+            maxSeconds = seekSeconds;
+    }
+
+    cout << "Seek latency: mean " << 1000 * totalSeconds / BENCH_SEEKS
+         << " ms, max " << 1000 * maxSeconds << " ms" << endl;
+
+    freeStepGraph(step);
+    freeTaskScheduler(scheduler);
+    freeKeyframeCache(cache);
+    freeOrbitalSim(sim);
+
+    return 0;
+}
@@ -11,9 +11,30 @@
 
 #include "orbitalSim.h"
 #include "orbitalSimView.h"
+#include "keyframeCache.h"
+#include "asteroidCatalog.h"
+#include "stepGraph.h"
+#include "clusterSim.h"
+#include "spatialIndex.h"
 #include <stdio.h>
 
 #define SECONDS_PER_DAY 86400.0F
+#define VIEW_SCALE 1E-11F   // Misma escala que renderOrbitalSim3D
+#define PICK_ANGLE 0.01F    // [rad] Ángulo máximo entre el rayo del mouse y el asteroide
+
+// Pasos de simulación por frame como máximo. Si los fps caen por debajo de fps / STEPS_PER_FRAME_MAX,
+// la simulación se frena en lugar de acumular atraso
+#define STEPS_PER_FRAME_MAX 4
+
+/**
+ * @brief Game loop for a cluster of star systems (CLUSTER_MODE)
+ *
+ * @param camera
+ * @param timeMultiplier
+ * @param fps
+ * @return int
+ */
+int runClusterSim(Camera3D &camera, float timeMultiplier, float fps);
 
 int main()
 {
@@ -38,6 +59,9 @@ int main()
     const float timeMultiplier = DAYS_PER_SECOND * SECONDS_PER_DAY; // Simulation speed: days per real second
     const float timeStep = timeMultiplier / fps;
 
+    if (CLUSTER_MODE)
+        return runClusterSim(camera, timeMultiplier, fps);
+
     OrbitalSim *sim = makeOrbitalSim(timeStep);
 
     if (!sim)
@@ -47,41 +71,164 @@ int main()
         return 1;
     }
 
+    // Antes de los keyframes, que dependen de la cantidad de cuerpos
+    if (ASTEROIDS_CATALOG[0] && loadAsteroidCatalog(sim, ASTEROIDS_CATALOG) < 0)
+        printf("No se pudo cargar %s, se usan asteroides sintéticos...\n", ASTEROIDS_CATALOG);
+
+    KeyframeCache *keyframes = makeKeyframeCache(sim, KEYFRAME_INTERVAL_DAYS, KEYFRAME_MEMORY_BUDGET);
+
+    if (!keyframes)
+    {
+        printf("No se pudo inicializar keyframeCache...\n");
+        freeOrbitalSim(sim);
+        CloseWindow();
+        return 1;
+    }
+
+    // Un paso de simulación, repartido en todos los núcleos, que captura los keyframes por bloque
+    TaskScheduler *scheduler = makeTaskScheduler(0);
+    StepGraph *step = scheduler ? makeStepGraph(sim, scheduler, captureKeyframeBlock, keyframes) : NULL;
+
+    if (!step)
+    {
+        printf("No se pudo inicializar el planificador...\n");
+        if (scheduler)
+            freeTaskScheduler(scheduler);
+        freeKeyframeCache(keyframes);
+        freeOrbitalSim(sim);
+        CloseWindow();
+        return 1;
+    }
+
+    // Sin índice se sigue, pero no se pueden elegir asteroides con el mouse
+    SpatialIndex *spatialIndex = makeSpatialIndex(sim);
+    int pickedBody = -1;
+
+    if (!spatialIndex)
+        printf("No se pudo inicializar spatialIndex...\n");
+
+    // Tiempo real transcurrido que todavía no se simuló [s]
+    float pendingTime = 0;
+
     // Game loop
     while (!WindowShouldClose())
     {
         // Update simulation
-        updateOrbitalSim(sim);
+        if (IsKeyPressed(KEY_LEFT))
+        {
+            float rewindTime = sim->time - REWIND_DAYS * SECONDS_PER_DAY;
+            seekOrbitalSim(keyframes, rewindTime > 0 ? rewindTime : 0, step, scheduler);
+            pendingTime = 0;
+        }
+        else
+        {
+            // El timeStep de la simulación es fijo: según los fps de raylib se da más o menos de un
+            // paso por frame. En un principio se ajustaba timeStep a los fps en cada frame, pero así
+            // no se puede volver a simular un tramo igual a la primera vez (ver keyframeCache)
+            pendingTime += GetFrameTime();
+            if (pendingTime > STEPS_PER_FRAME_MAX / fps)
+                pendingTime = STEPS_PER_FRAME_MAX / fps;
+
+            for (; pendingTime >= 1 / fps; pendingTime -= 1 / fps)
+            {
+                beginKeyframeCapture(keyframes);
+                updateOrbitalSimGraph(step, scheduler);
+                endKeyframeCapture(keyframes);
+            }
+        }
+
+        // Igual que si no se hubiera podido crear
+        if (spatialIndex && !updateSpatialIndex(spatialIndex))
+        {
+            printf("No se pudo reconstruir spatialIndex...\n");
+            freeSpatialIndex(spatialIndex);
+            spatialIndex = NULL;
+            pickedBody = -1;
+        }
 
         // Camera
         UpdateCamera(&camera);
 
+        // Asteroide más cercano al rayo bajo el mouse, llevado a la escala de la simulación
+        if (spatialIndex && IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
+        {
+            Ray ray = GetMouseRay(GetMousePosition(), camera);
+            ray.position = Vector3Scale(ray.position, 1 / VIEW_SCALE);
+
+            pickedBody = pickAsteroid(spatialIndex, ray, PICK_ANGLE, NULL);
+        }
+
         // Render
         BeginDrawing();
         ClearBackground(BLACK);
 
         BeginMode3D(camera);
         renderOrbitalSim3D(sim);
+        if (pickedBody >= 0)
+            renderPickedBody3D(sim, pickedBody);
         DrawGrid(10, 10.0f);
         EndMode3D();
 
         renderOrbitalSim2D(sim);
         EndDrawing();
-
-        // Se hacen coincidir FPS de raylib con los de la cuenta de timeStep para que
-        // este ultimo siempre "esté bien", sin importar los fps de raylib.
-        // En un principio se ponía un topo a los fps con SetTargetFPS, pero si eran
-        // menores al seteado, el avance temporal quedaba mal.
-        //
-        // Luego, se consigue NO limitar los fps, y que el timeStep siempre sea correcto.
-        //
-        // No se notaron impactos en el rendimiento al agregar una división en cada vuelta del loop
-        sim->timeStep = timeMultiplier / GetFPS();
     }
 
     CloseWindow();
 
+    if (spatialIndex)
+        freeSpatialIndex(spatialIndex);
+    freeStepGraph(step);
+    freeTaskScheduler(scheduler);
+    freeKeyframeCache(keyframes);
     freeOrbitalSim(sim);
 
     return 0;
 }
+
+int runClusterSim(Camera3D &camera, float timeMultiplier, float fps)
+{
+    TaskScheduler *scheduler = makeTaskScheduler(0);
+    ClusterSim *cluster = scheduler ? makeClusterSim(timeMultiplier / fps, CLUSTER_SYSTEMS_NUM, CLUSTER_ASTEROIDS_NUM) : NULL;
+
+    if (!cluster)
+    {
+        printf("No se pudo inicializar clusterSim...\n");
+        if (scheduler)
+            freeTaskScheduler(scheduler);
+        CloseWindow();
+        return 1;
+    }
+
+    float pendingTime = 0;
+
+    while (!WindowShouldClose())
+    {
+        // Igual que con un solo sistema (ver main)
+        pendingTime += GetFrameTime();
+        if (pendingTime > STEPS_PER_FRAME_MAX / fps)
+            pendingTime = STEPS_PER_FRAME_MAX / fps;
+
+        for (; pendingTime >= 1 / fps; pendingTime -= 1 / fps)
+            updateClusterSim(cluster, scheduler);
+
+        UpdateCamera(&camera);
+
+        BeginDrawing();
+        ClearBackground(BLACK);
+
+        BeginMode3D(camera);
+        renderClusterSim3D(cluster);
+        DrawGrid(10, 10.0f);
+        EndMode3D();
+
+        renderClusterSim2D(cluster);
+        EndDrawing();
+    }
+
+    CloseWindow();
+
+    freeClusterSim(cluster);
+    freeTaskScheduler(scheduler);
+
+    return 0;
+}
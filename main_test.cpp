@@ -8,14 +8,31 @@
  * Tests
  */
 
+#include <algorithm>
 #include <iostream>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "orbitalSim.h"
+#include "keyframeCache.h"
+#include "asteroidCatalog.h"
+#include "stepGraph.h"
+#include "clusterSim.h"
+#include "spatialIndex.h"
 
 #define SECONDS_PER_DAY 86400.0F
+#define ASTRONOMICAL_UNIT 1.495978707E11
+#define PI 3.14159265358979323846
 
 using namespace std;
 
+// Cuenta cuántas veces se completó cada bloque en el grafo de paso
+static void countStepBlock(OrbitalSim * /* sim */, int block, void *data)
+{
+    ((int *)data)[block]++;
+}
+
 int main()
 {
     float fps = 60.0F;                            // frames per second
@@ -40,5 +57,426 @@ int main()
     //     return 2;
     // }
 
+    // Keyframes: volver a un tiempo ya simulado tiene que dar exactamente el mismo estado
+    KeyframeCache *cache = makeKeyframeCache(sim, 10, 4 << 20);
+
+    OrbitalBody earthThen, asteroidThen;
+    float timeThen = 0;
+
+    for (int i = 0; i < 600; i++)
+    {
+        updateOrbitalSim(sim);
+        updateKeyframeCache(cache);
+
+        if (i == 250)
+        {
+            timeThen = sim->time;
+            earthThen = *sim->bodies[3];
+            asteroidThen = *sim->bodies[sim->bodyNum - 1];
+        }
+    }
+
+    OrbitalBody earthNow = *sim->bodies[3];
+    float timeNow = sim->time;
+
+    // 600 pasos de 100/60 días son 100 intervalos de 10 días: no entran en 4 MB sin ralear
+    size_t keyframeBytes = cache->keyframeNum * 2 * sim->bodyNum * sizeof(Vector3);
+
+    if (!cache->evictedNum || keyframeBytes > cache->memoryBudget)
+    {
+        cout << "KeyframeCache evicted " << cache->evictedNum << " keyframes, using "
+             << keyframeBytes << " bytes" << endl;
+        return 3;
+    }
+
+    if (!seekOrbitalSim(cache, timeThen, NULL, NULL) ||
+        sim->time != timeThen ||
+        memcmp(&sim->bodies[3]->position, &earthThen.position, sizeof(Vector3)) ||
+        memcmp(&sim->bodies[sim->bodyNum - 1]->velocity, &asteroidThen.velocity, sizeof(Vector3)))
+    {
+        cout << "KeyframeCache did not rewind correctly" << endl;
+        return 4;
+    }
+
+    if (!seekOrbitalSim(cache, timeNow, NULL, NULL) ||
+        memcmp(&sim->bodies[3]->position, &earthNow.position, sizeof(Vector3)))
+    {
+        cout << "KeyframeCache did not fast-forward correctly" << endl;
+        return 5;
+    }
+
+    // Al seguir simulando después de volver atrás, los keyframes de la corrida abandonada se descartan
+    seekOrbitalSim(cache, timeThen, NULL, NULL);
+    updateOrbitalSim(sim);
+    updateKeyframeCache(cache);
+
+    if (cache->keyframes[cache->keyframeNum - 1].time > sim->time)
+    {
+        cout << "KeyframeCache kept keyframes of an abandoned run" << endl;
+        return 15;
+    }
+
+    freeKeyframeCache(cache);
+    freeOrbitalSim(sim);
+
+    // Catálogo de asteroides: el estado de cada asteroide tiene que reproducir sus elementos, propagados
+    // desde la época del archivo (K2218 = 2022-01-08) a la de la simulación (2022-01-01)
+    sim = makeOrbitalSim(timeStep);
+
+    if (loadAsteroidCatalog(sim, MPCORB_SAMPLE_PATH) != 11 ||
+        sim->bodyNum != sim->bodyNumCore + 11)
+    {
+        cout << "AsteroidCatalog not loaded correctly" << endl;
+        return 6;
+    }
+
+    // M, n [grados, grados/día], perihelio, nodo, inclinación [grados], e, a [UA], como en mpcorb_sample.dat.
+    // El último, con e = 0.995 cerca del perihelio, necesita un valor inicial estable para Kepler
+    const double elements[][7] = {{291.40000, 0.21418276, 73.60000, 80.30000, 10.59000, 0.0785000, 2.7666000},
+                                  {272.00000, 0.21344170, 310.40000, 172.90000, 34.83000, 0.2301000, 2.7730000},
+                                  {195.00000, 0.22606328, 247.90000, 169.80000, 12.99000, 0.2569000, 2.6688000},
+                                  {45.00000, 0.27159524, 151.00000, 103.80000, 7.14000, 0.0887000, 2.3615000},
+                                  {50.00000, 0.23866639, 358.90000, 141.60000, 5.37000, 0.1909000, 2.5740000},
+                                  {300.00000, 0.26091687, 239.50000, 138.60000, 14.74000, 0.2026000, 2.4255000},
+                                  {100.00000, 0.26752369, 145.30000, 259.50000, 5.52000, 0.2296000, 2.3854000},
+                                  {20.00000, 0.30175580, 285.60000, 110.90000, 5.89000, 0.1561000, 2.2014000},
+                                  {150.00000, 0.55967223, 178.90000, 304.30000, 10.83000, 0.2226000, 1.4583000},
+                                  {200.00000, 1.11256433, 126.60000, 203.90000, 3.34000, 0.1915000, 0.9224000},
+                                  {358.32776, 0.18968028, 35.00000, 60.00000, 25.00000, 0.9950000, 3.0000000}};
+    double mu = 6.6743E-11 * sim->bodies[0]->mass;
+
+    for (int i = 0; i < 11; i++)
+    {
+        const double *element = elements[i];
+        double meanAnomaly = fmod((element[0] - 7 * element[1]) * PI / 180, 2 * PI);
+        double perihelion = element[2] * PI / 180;
+        double node = element[3] * PI / 180;
+        double inclination = element[4] * PI / 180;
+        double e = element[5];
+        double a = element[6] * ASTRONOMICAL_UNIT;
+
+        if (meanAnomaly > PI)
+            meanAnomaly -= 2 * PI;
+        else if (meanAnomaly < -PI)
+            meanAnomaly += 2 * PI;
+
+        // Anomalía excéntrica por bisección, independiente del cargador
+        double low = -PI - 1, high = PI + 1;
+        for (int j = 0; j < 100; j++)
+        {
+            double middle = (low + high) / 2;
+            (middle - e * sin(middle) < meanAnomaly ? low : high) = middle;
+        }
+        double E = (low + high) / 2;
+
+        OrbitalBody *asteroid = sim->bodies[sim->bodyNumCore + i];
+        Vector3 position = Vector3Subtract(asteroid->position, sim->bodies[0]->position);
+        Vector3 velocity = Vector3Subtract(asteroid->velocity, sim->bodies[0]->velocity);
+        double r = Vector3Length(position);
+        double v = Vector3Length(velocity);
+
+        // Semieje mayor (vis-viva) y anomalía excéntrica a partir del estado
+        double stateA = 1 / (2 / r - v * v / mu);
+        double eCosE = 1 - r / stateA;
+        double eSinE = ((double)position.x * velocity.x + (double)position.y * velocity.y +
+                        (double)position.z * velocity.z) /
+                       sqrt(mu * stateA);
+        double stateMeanAnomaly = atan2(eSinE, eCosE) - eSinE;
+
+        if (fabs(stateA - a) > 1E-3 * a)
+        {
+            cout << "AsteroidCatalog orbit " << i << " has a = " << stateA / ASTRONOMICAL_UNIT << " AU" << endl;
+            return 7;
+        }
+
+        if (fabs(remainder(stateMeanAnomaly - meanAnomaly, 2 * PI)) > 1E-4 ||
+            fabs(r - a * (1 - e * cos(E))) > 1E-4 * r)
+        {
+            cout << "AsteroidCatalog orbit " << i << " at r = " << r / ASTRONOMICAL_UNIT << " AU, expected "
+                 << a * (1 - e * cos(E)) / ASTRONOMICAL_UNIT << " AU" << endl;
+            return 20;
+        }
+
+        // Normal de la órbita y dirección del perihelio, en la simulación (x, z, y) de la eclíptica.
+        // Al intercambiar dos ejes, el producto vectorial cambia de signo
+        Vector3 normal = Vector3Normalize(Vector3CrossProduct(position, velocity));
+        Vector3 expectedNormal = {(float)(-sin(inclination) * sin(node)),
+                                  (float)-cos(inclination),
+                                  (float)(sin(inclination) * cos(node))};
+
+        Vector3 eccentricity = Vector3Subtract(Vector3Scale(Vector3CrossProduct(velocity, Vector3CrossProduct(position, velocity)),
+                                                            (float)(1 / mu)),
+                                               Vector3Scale(position, (float)(1 / r)));
+        Vector3 expectedPerihelion = {(float)(cos(perihelion) * cos(node) - sin(perihelion) * cos(inclination) * sin(node)),
+                                      (float)(sin(perihelion) * sin(inclination)),
+                                      (float)(cos(perihelion) * sin(node) + sin(perihelion) * cos(inclination) * cos(node))};
+
+        if (Vector3DotProduct(normal, expectedNormal) < 1 - 1E-6F ||
+            Vector3DotProduct(Vector3Normalize(eccentricity), expectedPerihelion) < 1 - 1E-4F)
+        {
+            cout << "AsteroidCatalog orbit " << i << " is not oriented as its elements" << endl;
+            return 21;
+        }
+    }
+
+    // Un archivo sin registros no deja a la simulación sin asteroides
+    FILE *emptyCatalog = fopen("orbitalsim_empty.dat", "w");
+
+    if (emptyCatalog)
+    {
+        fputs("Not an orbit catalog\n", emptyCatalog);
+        fclose(emptyCatalog);
+
+        int loaded = loadAsteroidCatalog(sim, "orbitalsim_empty.dat");
+        remove("orbitalsim_empty.dat");
+
+        if (loaded != -1 || sim->bodyNum != sim->bodyNumCore + 11)
+        {
+            cout << "AsteroidCatalog replaced the asteroids with an empty catalog" << endl;
+            return 22;
+        }
+    }
+
+    updateOrbitalSim(sim);
+    freeOrbitalSim(sim);
+
+    // Grafo de paso: con varios hilos tiene que dar exactamente lo mismo que updateOrbitalSim
+    OrbitalSim *serialSim = makeOrbitalSim(timeStep);
+    sim = makeOrbitalSim(timeStep);
+
+    for (int i = 0; i < sim->bodyNum; i++)
+        *sim->bodies[i] = *serialSim->bodies[i];
+
+    TaskScheduler *scheduler = makeTaskScheduler(4);
+    int blockCounts[ASTEROIDS_NUM / ORBITALSIM_BLOCK_SIZE_MIN + 1] = {0};
+    StepGraph *step = makeStepGraph(sim, scheduler, countStepBlock, blockCounts);
+
+    // Varios bloques por hilo, y la misma partición en la simulación serie
+    if (getOrbitalSimBlockNum(sim) < 4 * STEPGRAPH_BLOCKS_PER_THREAD)
+    {
+        cout << "StepGraph made only " << getOrbitalSimBlockNum(sim) << " blocks for 4 threads" << endl;
+        return 16;
+    }
+
+    serialSim->blockSize = sim->blockSize;
+
+    for (int i = 0; i < 20; i++)
+    {
+        updateOrbitalSim(serialSim);
+        updateOrbitalSimGraph(step, scheduler);
+    }
+
+    for (int i = 0; i < sim->bodyNum; i++)
+    {
+        if (memcmp(&sim->bodies[i]->position, &serialSim->bodies[i]->position, sizeof(Vector3)) ||
+            memcmp(&sim->bodies[i]->velocity, &serialSim->bodies[i]->velocity, sizeof(Vector3)))
+        {
+            cout << "StepGraph differs from updateOrbitalSim at body " << i << endl;
+            return 8;
+        }
+    }
+
+    for (int i = 0; i < getOrbitalSimBlockNum(sim); i++)
+    {
+        if (blockCounts[i] != 20)
+        {
+            cout << "StepGraph hook ran " << blockCounts[i] << " times on block " << i << endl;
+            return 9;
+        }
+    }
+
+    freeStepGraph(step);
+
+    // Keyframes capturados por bloque en el grafo, y seek volviendo a simular en el grafo
+    cache = makeKeyframeCache(sim, 1, 64 << 20);
+    step = makeStepGraph(sim, scheduler, captureKeyframeBlock, cache);
+
+    for (int i = 0; i < 5; i++)
+    {
+        beginKeyframeCapture(cache);
+        updateOrbitalSimGraph(step, scheduler);
+        endKeyframeCapture(cache);
+    }
+
+    Keyframe *keyframe = &cache->keyframes[cache->keyframeNum - 1];
+
+    if (cache->keyframeNum != 6 || keyframe->time != sim->time ||
+        memcmp(&keyframe->state[0], &sim->bodies[0]->position, sizeof(Vector3)) ||
+        memcmp(&keyframe->state[2 * (sim->bodyNum - 1) + 1], &sim->bodies[sim->bodyNum - 1]->velocity, sizeof(Vector3)))
+    {
+        cout << "StepGraph did not capture keyframes correctly" << endl;
+        return 17;
+    }
+
+    // Entre dos keyframes, para que el seek tenga que volver a simular
+    timeThen = (cache->keyframes[2].time + cache->keyframes[3].time) / 2;
+    seekOrbitalSim(cache, timeThen, NULL, NULL);
+    earthThen = *sim->bodies[3];
+
+    if (!seekOrbitalSim(cache, cache->keyframes[0].time, step, scheduler) ||
+        !seekOrbitalSim(cache, timeThen, step, scheduler) ||
+        memcmp(&sim->bodies[3]->position, &earthThen.position, sizeof(Vector3)))
+    {
+        cout << "StepGraph seek differs from the captured run" << endl;
+        return 18;
+    }
+
+    freeStepGraph(step);
+    freeKeyframeCache(cache);
+    freeOrbitalSim(serialSim);
+    freeOrbitalSim(sim);
+
+    // Cúmulo: el integrador externo conserva el momento total, y cada sistema su baricentro
+    ClusterSim *cluster = makeClusterSim(timeStep, 8, 100);
+
+    for (int i = 0; i < 5 * CLUSTER_OUTER_STEP_RATIO; i++)
+        updateClusterSim(cluster, scheduler);
+
+    double momentum = 0, momentumScale = 0;
+    for (int i = 0; i < cluster->systemNum; i++)
+    {
+        momentum += cluster->masses[i] * cluster->velocities[i].x;
+        momentumScale += cluster->masses[i] * fabs(cluster->velocities[i].x);
+    }
+
+    if (fabs(momentum) > 1E-9 * momentumScale)
+    {
+        cout << "ClusterSim does not conserve momentum" << endl;
+        return 10;
+    }
+
+    for (int i = 0; i < cluster->systemNum; i++)
+    {
+        OrbitalSim *system = cluster->systems[i];
+        double barycentre = 0;
+
+        for (int j = 0; j < system->bodyNum; j++)
+            barycentre += (double)system->bodies[j]->mass * system->bodies[j]->position.x;
+        barycentre /= cluster->masses[i];
+
+        if (fabs(system->time - cluster->time) > 1E-6 * cluster->time || fabs(barycentre) > 1E6)
+        {
+            cout << "ClusterSim system " << i << " out of sync or drifted " << barycentre << " m" << endl;
+            return 11;
+        }
+    }
+
+    // Entre pasos externos el baricentro se extrapola: al dar el paso externo no salta
+    for (int i = 0; i < CLUSTER_OUTER_STEP_RATIO - 1; i++)
+        updateClusterSim(cluster, scheduler);
+
+    Vector3 star = cluster->systems[0]->bodies[0]->position;
+    double before = getClusterBodyPosition(cluster, 0, 0).x - star.x;
+
+    updateClusterSim(cluster, scheduler);
+
+    star = cluster->systems[0]->bodies[0]->position;
+    double jump = getClusterBodyPosition(cluster, 0, 0).x - star.x - before;
+
+    if (fabs(jump) > 2 * fabs(cluster->velocities[0].x) * cluster->timeStep + 1)
+    {
+        cout << "ClusterSim barycentre jumped " << jump << " m in one step" << endl;
+        return 19;
+    }
+
+    freeClusterSim(cluster);
+    freeTaskScheduler(scheduler);
+
+    // Índice espacial: las mismas respuestas que recorrer todos los asteroides
+    sim = makeOrbitalSim(timeStep);
+    SpatialIndex *spatialIndex = makeSpatialIndex(sim);
+
+    for (int i = 0; i < 60; i++)
+    {
+        updateOrbitalSim(sim);
+        updateSpatialIndex(spatialIndex);
+    }
+
+    Vector3 earth = sim->bodies[3]->position;
+    float radius = 0.3F * (float)ASTRONOMICAL_UNIT;
+    int nearEarth[ASTEROIDS_NUM];
+    int nearEarthNum = 0;
+    float nearestDistances[5] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
+
+    for (int i = sim->bodyNumCore; i < sim->bodyNum; i++)
+    {
+        Vector3 diff = Vector3Subtract(sim->bodies[i]->position, earth);
+        float distance = sqrtf(Vector3DotProduct(diff, diff));
+
+        if (distance * distance <= radius * radius)
+            nearEarth[nearEarthNum++] = i;
+
+        for (int j = 0; j < 5; j++)
+        {
+            if (distance < nearestDistances[j])
+            {
+                memmove(&nearestDistances[j + 1], &nearestDistances[j], (4 - j) * sizeof(float));
+                nearestDistances[j] = distance;
+                break;
+            }
+        }
+    }
+
+    int results[ASTEROIDS_NUM];
+    float distances[5];
+
+    int resultNum = findAsteroidsInRadius(spatialIndex, earth, radius, results, ASTEROIDS_NUM);
+
+    // Los mismos asteroides, en cualquier orden
+    sort(results, results + (resultNum < ASTEROIDS_NUM ? resultNum : ASTEROIDS_NUM));
+
+    if (resultNum != nearEarthNum || memcmp(results, nearEarth, nearEarthNum * sizeof(int)))
+    {
+        cout << "SpatialIndex radius query differs from linear scan" << endl;
+        return 12;
+    }
+
+    if (findNearestAsteroids(spatialIndex, earth, 5, results, distances) != 5 ||
+        memcmp(distances, nearestDistances, sizeof(distances)))
+    {
+        cout << "SpatialIndex k-nearest query differs from linear scan" << endl;
+        return 13;
+    }
+
+    // Rayo desde arriba del plano, apuntando a un asteroide
+    Ray ray = {{0, 5E11F, 0}, Vector3Subtract(sim->bodies[sim->bodyNum / 2]->position, {0, 5E11F, 0})};
+    Vector3 direction = Vector3Normalize(ray.direction);
+    int pickedBody = -1;
+    float pickedTan = tanf(0.02F);
+    float pickedTanSqr = pickedTan * pickedTan;
+
+    for (int i = sim->bodyNumCore; i < sim->bodyNum; i++)
+    {
+        Vector3 diff = Vector3Subtract(sim->bodies[i]->position, ray.position);
+        float along = Vector3DotProduct(diff, direction);
+        Vector3 offset = Vector3Subtract(diff, Vector3Scale(direction, along));
+        float tanSqr = Vector3DotProduct(offset, offset) / (along * along);
+
+        if (along > 0 && tanSqr <= pickedTanSqr)
+        {
+            pickedBody = i;
+            pickedTanSqr = tanSqr;
+        }
+    }
+
+    if (pickAsteroid(spatialIndex, ray, 0.02F, NULL) != pickedBody)
+    {
+        cout << "SpatialIndex ray pick differs from linear scan" << endl;
+        return 14;
+    }
+
+    // Al cambiar la cantidad de cuerpos se reconstruye con los nuevos
+    loadAsteroidCatalog(sim, MPCORB_SAMPLE_PATH);
+
+    if (!updateSpatialIndex(spatialIndex) ||
+        findAsteroidsInRadius(spatialIndex, sim->bodies[0]->position, 1E13F, results, ASTEROIDS_NUM) != 11)
+    {
+        cout << "SpatialIndex not rebuilt after the number of bodies changed" << endl;
+        return 23;
+    }
+
+    freeSpatialIndex(spatialIndex);
+    freeOrbitalSim(sim);
+
     return 0;
 }
@@ -74,13 +74,21 @@ unsigned char getRandomUChar(unsigned char min, unsigned max);
  */
 void placeAsteroid(OrbitalBody *body, float centerMass);
 
+/**
+ * @brief Se integra discretamente la aceleración, para obtener velocidad y posición
+ *
+ * @param body
+ * @param timeStep
+ */
+void integrateBody(OrbitalBody *body, float timeStep);
+
 OrbitalSim *makeOrbitalSim(float timeStep)
 {
     int i;
-    int systemBodyNumCore, systemBodyNum;
+    int systemBodyNumCore;
 
     OrbitalSim *tempOrbitalSim = NULL;
-    OrbitalBody **bodies = NULL;
+    OrbitalBody *coreBodies = NULL;
     EphemeridesBody *systemInfo;
 
     switch (CHOSEN_SYSTEM)
@@ -103,13 +111,10 @@ OrbitalSim *makeOrbitalSim(float timeStep)
         break;
     }
 
-    systemBodyNum = systemBodyNumCore + ASTEROIDS_NUM;
-
     /*********BLACK_HOLE*********/
     if (BLACK_HOLE)
     {
         systemBodyNumCore++;
-        systemBodyNum++;
     }
 
     // Template de black hole, con posicion y velocidad iniciales totalmente empíricos
@@ -121,6 +126,43 @@ OrbitalSim *makeOrbitalSim(float timeStep)
                                 DARKGRAY};
     /*********BLACK_HOLE*********/
 
+    if (!(coreBodies = (OrbitalBody *)malloc(systemBodyNumCore * sizeof(OrbitalBody))))
+        return NULL;
+
+    for (i = 0; i < systemBodyNumCore; i++)
+    {
+        if (BLACK_HOLE && (i == systemBodyNumCore - 1))
+        {
+            coreBodies[i] = blacky;
+        }
+
+        // Cuerpos principales del sistema (no asteroides)
+        else
+        {
+            coreBodies[i] = {systemInfo[i].position,
+                             systemInfo[i].velocity,
+                             Vector3Zero(),
+                             systemInfo[i].mass,
+                             systemInfo[i].radius,
+                             systemInfo[i].color};
+        }
+    }
+
+    tempOrbitalSim = makeOrbitalSimSystem(timeStep, coreBodies, systemBodyNumCore, ASTEROIDS_NUM);
+
+    free(coreBodies);
+
+    return tempOrbitalSim;
+}
+
+OrbitalSim *makeOrbitalSimSystem(float timeStep, const OrbitalBody *coreBodies, int bodyNumCore, int asteroidNum)
+{
+    int i;
+    int systemBodyNum = bodyNumCore + asteroidNum;
+
+    OrbitalSim *tempOrbitalSim = NULL;
+    OrbitalBody **bodies = NULL;
+
     if (!(tempOrbitalSim = (OrbitalSim *)malloc(sizeof(OrbitalSim))))
         return NULL;
 
@@ -130,14 +172,14 @@ OrbitalSim *makeOrbitalSim(float timeStep)
         return NULL;
     }
 
-    *tempOrbitalSim = {timeStep, 0, systemBodyNumCore, systemBodyNum, bodies};
+    *tempOrbitalSim = {timeStep, 0, bodyNumCore, systemBodyNum, bodies, NULL, ORBITALSIM_BLOCK_SIZE, NULL, 0};
 
     for (i = 0; i < systemBodyNum; i++)
     {
         if (!(bodies[i] = (OrbitalBody *)malloc(sizeof(OrbitalBody))))
         {
             int j;
-            for (j = 0; j < i - 1; j++)
+            for (j = 0; j < i; j++)
                 free(bodies[j]);
 
             free(bodies);
@@ -146,20 +188,9 @@ OrbitalSim *makeOrbitalSim(float timeStep)
             return NULL;
         }
 
-        if (BLACK_HOLE && (i == systemBodyNumCore - 1))
-        {
-            *(bodies[i]) = blacky;
-        }
-
-        // Cuerpos principales del sistema (no asteroides)
-        else if (i < systemBodyNumCore)
+        if (i < bodyNumCore)
         {
-            *(bodies[i]) = {systemInfo[i].position,
-                            systemInfo[i].velocity,
-                            Vector3Zero(),
-                            systemInfo[i].mass,
-                            systemInfo[i].radius,
-                            systemInfo[i].color};
+            *(bodies[i]) = coreBodies[i];
         }
 
         else
@@ -174,18 +205,64 @@ OrbitalSim *makeOrbitalSim(float timeStep)
 // Simulates a timestep
 void updateOrbitalSim(OrbitalSim *sim)
 {
-    int i, j;
+    int block;
 
-    sim->time += sim->timeStep;
+    if (!reserveOrbitalSimBlocks(sim))
+        return;
+
+    computeOrbitalSimCoreForces(sim);
+
+    for (block = 0; block < getOrbitalSimBlockNum(sim); block++)
+    {
+        computeOrbitalSimBlockForces(sim, block);
+        integrateOrbitalSimBlock(sim, block);
+    }
+
+    integrateOrbitalSimCore(sim);
+}
+
+int getOrbitalSimBlockNum(OrbitalSim *sim)
+{
+    return (sim->bodyNum - sim->bodyNumCore + sim->blockSize - 1) / sim->blockSize;
+}
+
+void getOrbitalSimBlockRange(OrbitalSim *sim, int block, int *first, int *last)
+{
+    *first = sim->bodyNumCore + block * sim->blockSize;
+    *last = *first + sim->blockSize < sim->bodyNum ? *first + sim->blockSize : sim->bodyNum;
+}
+
+bool reserveOrbitalSimBlocks(OrbitalSim *sim)
+{
+    int blockAccelerationNum = getOrbitalSimBlockNum(sim) * sim->bodyNumCore;
+
+    if (blockAccelerationNum <= sim->blockAccelerationNum)
+        return true;
+
+    Vector3 *blockAccelerations = (Vector3 *)realloc(sim->blockAccelerations,
+                                                     blockAccelerationNum * sizeof(Vector3));
+
+    if (!blockAccelerations)
+        return false;
+
+    sim->blockAccelerations = blockAccelerations;
+    sim->blockAccelerationNum = blockAccelerationNum;
 
-    for (i = 0; i < sim->bodyNum; i++)
+    return true;
+}
+
+void computeOrbitalSimCoreForces(OrbitalSim *sim)
+{
+    int i, j;
+
+    for (i = 0; i < sim->bodyNumCore; i++)
     {
         sim->bodies[i]->acceleration = Vector3Zero();
     }
 
     for (i = 0; i < sim->bodyNumCore; i++)
     {
-        for (j = i + 1; j < sim->bodyNum; j++)
+        for (j = i + 1; j < sim->bodyNumCore; j++)
         {
             // Parte vectorial
             Vector3 vectorDiff = Vector3Subtract(sim->bodies[i]->position,
@@ -211,29 +288,92 @@ void updateOrbitalSim(OrbitalSim *sim)
                                                                    (-1.0F) * sim->bodies[i]->mass / vectorLen));
         }
     }
+}
+
+void computeOrbitalSimBlockForces(OrbitalSim *sim, int block)
+{
+    int i, j, first, last;
+
+    getOrbitalSimBlockRange(sim, block, &first, &last);
+
+    // Aporte del bloque a la aceleración de los cuerpos principales, que se suma en integrateOrbitalSimCore
+    Vector3 *blockAccelerations = &sim->blockAccelerations[block * sim->bodyNumCore];
+
+    for (i = 0; i < sim->bodyNumCore; i++)
+    {
+        blockAccelerations[i] = Vector3Zero();
+    }
 
-    // Se integra discretamente la aceleración, para obtener velocidad y posición
-    for (i = 0; i < sim->bodyNum; i++)
+    for (j = first; j < last; j++)
     {
-        Vector3 velocity = Vector3Add(sim->bodies[i]->velocity,
-                                      Vector3Scale(sim->bodies[i]->acceleration,
-                                                   sim->timeStep));
+        sim->bodies[j]->acceleration = Vector3Zero();
+    }
+
+    for (i = 0; i < sim->bodyNumCore; i++)
+    {
+        for (j = first; j < last; j++)
+        {
+            Vector3 vectorDiff = Vector3Subtract(sim->bodies[i]->position,
+                                                 sim->bodies[j]->position);
+
+            float vectorLen = Vector3Length(vectorDiff);
 
-        sim->bodies[i]->velocity = velocity;
+            Vector3 partialAcceleration = Vector3Scale(vectorDiff,
+                                                       (-1.0F) *
+                                                           GRAVITATIONAL_CONSTANT /
+                                                           (vectorLen * vectorLen));
 
-        sim->bodies[i]->position = Vector3Add(sim->bodies[i]->position,
-                                              Vector3Scale(velocity,
-                                                           sim->timeStep));
+            blockAccelerations[i] = Vector3Add(blockAccelerations[i],
+                                               Vector3Scale(partialAcceleration,
+                                                            sim->bodies[j]->mass / vectorLen));
+
+            sim->bodies[j]->acceleration = Vector3Add(sim->bodies[j]->acceleration,
+                                                      Vector3Scale(partialAcceleration,
+                                                                   (-1.0F) * sim->bodies[i]->mass / vectorLen));
+        }
     }
 }
 
+void integrateOrbitalSimBlock(OrbitalSim *sim, int block)
+{
+    int i, first, last;
+
+    getOrbitalSimBlockRange(sim, block, &first, &last);
+
+    for (i = first; i < last; i++)
+        integrateBody(sim->bodies[i], sim->timeStep);
+}
+
+void integrateOrbitalSimCore(OrbitalSim *sim)
+{
+    int i, block;
+    int blockNum = getOrbitalSimBlockNum(sim);
+
+    // Siempre en el mismo orden, para que el resultado no dependa de qué hilo calculó cada bloque
+    for (i = 0; i < sim->bodyNumCore; i++)
+    {
+        for (block = 0; block < blockNum; block++)
+            sim->bodies[i]->acceleration = Vector3Add(sim->bodies[i]->acceleration,
+                                                      sim->blockAccelerations[block * sim->bodyNumCore + i]);
+
+        integrateBody(sim->bodies[i], sim->timeStep);
+    }
+
+    sim->time += sim->timeStep;
+}
+
 void freeOrbitalSim(OrbitalSim *sim)
 {
     int i;
 
-    for (i = 0; i < sim->bodyNum; i++)
+    // Los asteroides de un catálogo comparten un único bloque
+    int bodyNumAllocated = sim->asteroidPool ? sim->bodyNumCore : sim->bodyNum;
+
+    for (i = 0; i < bodyNumAllocated; i++)
         free(sim->bodies[i]);
 
+    free(sim->asteroidPool);
+    free(sim->blockAccelerations);
     free(sim->bodies);
     free(sim);
 }
@@ -277,3 +417,16 @@ void placeAsteroid(OrbitalBody *body, float centerMass)
 
     body->velocity = {-v * sinf(phi), vy, v * cosf(phi)};
 }
+
+void integrateBody(OrbitalBody *body, float timeStep)
+{
+    Vector3 velocity = Vector3Add(body->velocity,
+                                  Vector3Scale(body->acceleration,
+                                               timeStep));
+
+    body->velocity = velocity;
+
+    body->position = Vector3Add(body->position,
+                                Vector3Scale(velocity,
+                                             timeStep));
+}
@@ -32,6 +32,9 @@ enum PLANETARY_SYSTEMS
 // Se llegó 30FPS con 50000 asteroides en Linux
 #define ASTEROIDS_NUM 10000
 
+// Ruta a un catálogo MPCORB.DAT para usar asteroides reales en lugar de ASTEROIDS_NUM, o ""
+#define ASTEROIDS_CATALOG ""
+
 #define TWEAK_JUPITER_MASS false // true or false
 #define JUPITER_ID 5
 #define TWEAK_JUPITER_MASS_FACTOR 1000 // veces de la masa de Júpiter
@@ -39,6 +42,14 @@ enum PLANETARY_SYSTEMS
 #define BLACK_HOLE false             // true or false
 #define BLACK_HOLE_MASS_FACTOR 10000 // veces de la masa mayor del sistema
 
+#define CLUSTER_MODE false        // true: cúmulo sintético en lugar de CHOSEN_SYSTEM
+#define CLUSTER_SYSTEMS_NUM 200   // sistemas del cúmulo
+#define CLUSTER_ASTEROIDS_NUM 500 // asteroides por sistema
+
+#define KEYFRAME_INTERVAL_DAYS 30         // días simulados entre keyframes
+#define KEYFRAME_MEMORY_BUDGET (256 << 20) // bytes para keyframes
+#define REWIND_DAYS 365                    // retroceso con flecha izquierda
+
 #define PARTY_TIME true // true or false
 #define EASTER_EGG true // true or false
 
@@ -63,14 +74,55 @@ struct OrbitalSim
     int bodyNumCore;
     int bodyNum;
     OrbitalBody **bodies;
+    OrbitalBody *asteroidPool; // Asteroides cargados en un solo bloque, o NULL
+
+    int blockSize;               // Asteroides por bloque, ver getOrbitalSimBlockNum
+    Vector3 *blockAccelerations; // Aporte de cada bloque de asteroides a los cuerpos principales
+    int blockAccelerationNum;
 };
 
 // Makes an orbital simulation, with a given update timestep
 OrbitalSim *makeOrbitalSim(float timeStep);
 
+// Makes an orbital simulation from the given core bodies (copied), with asteroidNum asteroids
+// orbiting the first one
+OrbitalSim *makeOrbitalSimSystem(float timeStep, const OrbitalBody *coreBodies, int bodyNumCore, int asteroidNum);
+
 // Updates a given orbital simulation
 void updateOrbitalSim(OrbitalSim *sim);
 
+/*
+ * Etapas de updateOrbitalSim. Los asteroides se procesan en bloques de sim->blockSize, para que un
+ * planificador pueda integrar un bloque mientras otro todavía calcula fuerzas. Orden requerido:
+ * reserveOrbitalSimBlocks; computeOrbitalSimBlockForces(k) antes de integrateOrbitalSimBlock(k);
+ * computeOrbitalSimCoreForces y todos los computeOrbitalSimBlockForces antes de integrateOrbitalSimCore.
+ * El resultado depende del tamaño de bloque (las sumas parciales cambian), no de quién ejecuta las etapas.
+ */
+
+#define ORBITALSIM_BLOCK_SIZE 2048   // Tamaño inicial de bloque
+#define ORBITALSIM_BLOCK_SIZE_MIN 256 // Por debajo, el costo de cada tarea supera al del bloque
+
+// Number of asteroid blocks of a given orbital simulation
+int getOrbitalSimBlockNum(OrbitalSim *sim);
+
+// Range [first, last) of sim->bodies covered by an asteroid block
+void getOrbitalSimBlockRange(OrbitalSim *sim, int block, int *first, int *last);
+
+// Makes room for the per block partial accelerations. Returns false if out of memory
+bool reserveOrbitalSimBlocks(OrbitalSim *sim);
+
+// Computes the accelerations between core bodies
+void computeOrbitalSimCoreForces(OrbitalSim *sim);
+
+// Computes the accelerations between core bodies and the asteroids of a block
+void computeOrbitalSimBlockForces(OrbitalSim *sim, int block);
+
+// Integrates the asteroids of a block
+void integrateOrbitalSimBlock(OrbitalSim *sim, int block);
+
+// Adds up the block accelerations, integrates the core bodies and advances the time
+void integrateOrbitalSimCore(OrbitalSim *sim);
+
 // Destroys a given orbital simulation
 void freeOrbitalSim(OrbitalSim *sim);
 
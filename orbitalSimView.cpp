@@ -51,11 +51,18 @@ void renderOrbitalSim3D(OrbitalSim *sim)
     }
 }
 
+void renderPickedBody3D(OrbitalSim *sim, int body)
+{
+    Vector3 position = Vector3Scale(sim->bodies[body]->position, 1E-11F);
+
+    DrawSphereWires(position, 0.05F, 8, 8, WHITE);
+}
+
 void renderOrbitalSim2D(OrbitalSim *sim)
 {
     static int coreNum = sim->bodyNumCore;
 
-    char auxiliarString[6];
+    char auxiliarString[12];
 
     DrawFPS(0, 0);
 
@@ -81,7 +88,7 @@ void renderOrbitalSim2D(OrbitalSim *sim)
     DrawText(auxiliarString, 0, 95, 14, GOLD);
 
     DrawText("Asteroids: ", 0, 115, 14, GOLD);
-    sprintf(auxiliarString, "%d", ASTEROIDS_NUM);
+    sprintf(auxiliarString, "%d", sim->bodyNum - sim->bodyNumCore);
     DrawText(auxiliarString, 0, 130, 14, GOLD);
 
     if (BLACK_HOLE)
@@ -99,6 +106,54 @@ void renderOrbitalSim2D(OrbitalSim *sim)
     }
 }
 
+void renderClusterSim3D(ClusterSim *cluster)
+{
+    int i, j;
+
+    // Escala del cúmulo: los sistemas quedan a unidades de distancia, y cada uno casi en un punto
+    for (i = 0; i < cluster->systemNum; i++)
+    {
+        OrbitalSim *system = cluster->systems[i];
+
+        for (j = 0; j < system->bodyNum; j++)
+        {
+            ClusterVector position = getClusterBodyPosition(cluster, i, j);
+            Vector3 scaledPosition = {(float)(position.x * 1E-14),
+                                      (float)(position.y * 1E-14),
+                                      (float)(position.z * 1E-14)};
+
+            // Sólo la estrella como esfera
+            if (j == 0)
+            {
+                DrawSphere(scaledPosition,
+                           logf(system->bodies[j]->radius) * 0.002F,
+                           system->bodies[j]->color);
+            }
+
+            DrawPoint3D(scaledPosition, system->bodies[j]->color);
+        }
+    }
+}
+
+void renderClusterSim2D(ClusterSim *cluster)
+{
+    int i;
+    int asteroidNum = 0;
+
+    for (i = 0; i < cluster->systemNum; i++)
+        asteroidNum += cluster->systems[i]->bodyNum - cluster->systems[i]->bodyNumCore;
+
+    DrawFPS(0, 0);
+
+    DrawText(getISODate((float)cluster->time), 0, 25, 14, GOLD);
+
+    DrawText("Star systems: ", 0, 45, 14, GOLD);
+    DrawText(TextFormat("%d", cluster->systemNum), 0, 60, 14, GOLD);
+
+    DrawText("Asteroids: ", 0, 80, 14, GOLD);
+    DrawText(TextFormat("%d", asteroidNum), 0, 95, 14, GOLD);
+}
+
 const char *getISODate(float currentTime)
 {
     // Epoch: 2022-01-01
@@ -13,11 +13,21 @@
 #define ORBITALSIMVIEW_H
 
 #include "orbitalSim.h"
+#include "clusterSim.h"
 
 // Renders the 3D views of a given orbital simulation
 void renderOrbitalSim3D(OrbitalSim *sim);
 
+// Highlights a body of a given orbital simulation
+void renderPickedBody3D(OrbitalSim *sim, int body);
+
 // Renders simulation data
 void renderOrbitalSim2D(OrbitalSim *sim);
 
+// Renders the 3D views of a given cluster of star systems
+void renderClusterSim3D(ClusterSim *cluster);
+
+// Renders cluster data
+void renderClusterSim2D(ClusterSim *cluster);
+
 #endif
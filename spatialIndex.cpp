@@ -0,0 +1,550 @@
+/**
+ * @file spatialIndex.cpp
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Asteroid spatial index. Consultas de proximidad
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Sobre la estructura: es una BVH lineal. Los asteroides se ordenan por código de Morton (intercalando los
+ *      bits de x, y, z cuantizados), de modo que asteroides consecutivos quedan cerca en el espacio, y se
+ *      agrupan de a SPATIALINDEX_LEAF_SIZE en hojas. Sobre las hojas se arma un árbol binario completo
+ *      guardado en un arreglo, sin punteros: cada nodo tiene la caja de sus dos hijos.
+ *
+ * Sobre la actualización: en cada paso los asteroides se mueven poco, así que alcanza con recalcular las
+ *      cajas con el mismo orden (refit), en O(n) y sin reservar memoria. Con el tiempo los asteroides de una
+ *      hoja se separan y las cajas crecen; cuando su superficie total supera SPATIALINDEX_REBUILD_RATIO veces
+ *      la de la última construcción, se vuelve a ordenar todo.
+ *
+ * Sobre las consultas: se recorre el árbol con una pila, descartando los nodos cuya caja no puede contener
+ *      resultados. Las distancias finales se calculan con las posiciones actuales de sim->bodies.
+ *
+ */
+
+#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spatialIndex.h"
+
+#define MORTON_BITS 10      // Bits por eje
+#define RADIX_BITS 15       // Dos pasadas para los 30 bits del código
+#define SPATIALINDEX_STACK 64
+
+/**
+ * @brief Sort the asteroids by Morton code and size the tree for them
+ *
+ * @param index
+ * @return true on success
+ */
+static bool buildSpatialIndex(SpatialIndex *index);
+
+/**
+ * @brief Recompute every box from the current positions
+ *
+ * @param index
+ * @return float Total surface of the internal boxes
+ */
+static float refitSpatialIndex(SpatialIndex *index);
+
+/**
+ * @brief Spread the lower 10 bits of a value every third bit
+ *
+ * @param value
+ * @return uint32_t
+ */
+static uint32_t expandMortonBits(uint32_t value);
+
+/**
+ * @brief Squared distance from a point to a box, 0 if inside
+ *
+ * @param box
+ * @param point
+ * @return float
+ */
+static float getBoxDistanceSqr(const SpatialBox *box, Vector3 point);
+
+/**
+ * @brief Check whether a ray (ahead of its origin) crosses a box grown by margin on every side
+ *
+ * @param box
+ * @param ray
+ * @param margin
+ * @return true if crosses
+ */
+static bool isBoxHitByRay(const SpatialBox *box, Ray ray, float margin);
+
+/**
+ * @brief Get the distance from a point to the farthest corner of a box
+ *
+ * @param box
+ * @param point
+ * @return float
+ */
+static float getBoxFarthestDistance(const SpatialBox *box, Vector3 point);
+
+/**
+ * @brief Get the range of positions in order covered by a leaf
+ *
+ * @param index
+ * @param leaf
+ * @param first
+ * @param last One past the end
+ */
+static void getLeafRange(SpatialIndex *index, int leaf, int *first, int *last);
+
+static bool isBoxEmpty(const SpatialBox *box)
+{
+    return box->min.x > box->max.x;
+}
+
+SpatialIndex *makeSpatialIndex(OrbitalSim *sim)
+{
+    SpatialIndex *index = NULL;
+
+    if (!(index = (SpatialIndex *)malloc(sizeof(SpatialIndex))))
+        return NULL;
+
+    *index = {sim, 0, NULL, 0, 0, NULL, 0, 0};
+
+    if (!buildSpatialIndex(index))
+    {
+        freeSpatialIndex(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+bool updateSpatialIndex(SpatialIndex *index)
+{
+    if (index->bodyNum != index->sim->bodyNum)
+    {
+        if (buildSpatialIndex(index))
+            return true;
+
+        // order se refiere a los cuerpos anteriores: sin hojas, las consultas no lo leen
+        index->leafNum = 0;
+        return false;
+    }
+
+    // Si no se puede reconstruir, el árbol recién ajustado sigue siendo correcto, aunque más lento
+    if (refitSpatialIndex(index) > SPATIALINDEX_REBUILD_RATIO * index->builtArea)
+        buildSpatialIndex(index);
+
+    return true;
+}
+
+int findAsteroidsInRadius(SpatialIndex *index, Vector3 center, float radius, int *results, int maxResults)
+{
+    int stack[SPATIALINDEX_STACK];
+    int stackNum = 0;
+    int resultNum = 0;
+    float radiusSqr = radius * radius;
+
+    if (!index->leafNum)
+        return 0;
+
+    stack[stackNum++] = 1;
+
+    while (stackNum)
+    {
+        int node = stack[--stackNum];
+
+        if (isBoxEmpty(&index->nodes[node]) || getBoxDistanceSqr(&index->nodes[node], center) > radiusSqr)
+            continue;
+
+        if (node < index->leafBase)
+        {
+            stack[stackNum++] = 2 * node + 1;
+            stack[stackNum++] = 2 * node;
+            continue;
+        }
+
+        int i, first, last;
+        getLeafRange(index, node - index->leafBase, &first, &last);
+
+        for (i = first; i < last; i++)
+        {
+            int body = index->order[i];
+            Vector3 diff = Vector3Subtract(index->sim->bodies[body]->position, center);
+
+            if (Vector3DotProduct(diff, diff) <= radiusSqr)
+            {
+                if (resultNum < maxResults)
+                    results[resultNum] = body;
+                resultNum++;
+            }
+        }
+    }
+
+    return resultNum;
+}
+
+int findNearestAsteroids(SpatialIndex *index, Vector3 point, int k, int *results, float *distances)
+{
+    int stack[SPATIALINDEX_STACK];
+    int stackNum = 0;
+    int resultNum = 0;
+
+    if (!index->leafNum || k <= 0)
+        return 0;
+
+    stack[stackNum++] = 1;
+
+    while (stackNum)
+    {
+        int node = stack[--stackNum];
+
+        if (isBoxEmpty(&index->nodes[node]) ||
+            (resultNum == k && getBoxDistanceSqr(&index->nodes[node], point) >= distances[k - 1]))
+            continue;
+
+        if (node < index->leafBase)
+        {
+            // Primero el hijo más cercano, que achica antes el radio de búsqueda
+            int near = 2 * node, far = 2 * node + 1;
+
+            if (getBoxDistanceSqr(&index->nodes[far], point) < getBoxDistanceSqr(&index->nodes[near], point))
+            {
+                near = 2 * node + 1;
+                far = 2 * node;
+            }
+
+            stack[stackNum++] = far;
+            stack[stackNum++] = near;
+            continue;
+        }
+
+        int i, j, first, last;
+        getLeafRange(index, node - index->leafBase, &first, &last);
+
+        for (i = first; i < last; i++)
+        {
+            int body = index->order[i];
+            Vector3 diff = Vector3Subtract(index->sim->bodies[body]->position, point);
+            float distanceSqr = Vector3DotProduct(diff, diff);
+
+            if (resultNum == k && distanceSqr >= distances[k - 1])
+                continue;
+
+            // Inserción ordenada: k suele ser chico
+            if (resultNum < k)
+                resultNum++;
+
+            for (j = resultNum - 1; j > 0 && distances[j - 1] > distanceSqr; j--)
+            {
+                distances[j] = distances[j - 1];
+                results[j] = results[j - 1];
+            }
+
+            distances[j] = distanceSqr;
+            results[j] = body;
+        }
+    }
+
+    // Durante la búsqueda se guardaron las distancias al cuadrado
+    for (int i = 0; i < resultNum; i++)
+        distances[i] = sqrtf(distances[i]);
+
+    return resultNum;
+}
+
+int pickAsteroid(SpatialIndex *index, Ray ray, float maxAngle, float *angle)
+{
+    int stack[SPATIALINDEX_STACK];
+    int stackNum = 0;
+    int picked = -1;
+    float pickedTan = tanf(maxAngle);
+    float pickedTanSqr = pickedTan * pickedTan;
+
+    if (!index->leafNum)
+        return -1;
+
+    ray.direction = Vector3Normalize(ray.direction);
+
+    stack[stackNum++] = 1;
+
+    while (stackNum)
+    {
+        int node = stack[--stackNum];
+        SpatialBox *box = &index->nodes[node];
+
+        // Ningún punto de la caja está más lejos del origen que su esquina más lejana, así que tampoco
+        // puede estar más lejos del rayo que esa distancia por la tangente del mejor ángulo
+        if (isBoxEmpty(box) ||
+            !isBoxHitByRay(box, ray, getBoxFarthestDistance(box, ray.position) * sqrtf(pickedTanSqr)))
+            continue;
+
+        if (node < index->leafBase)
+        {
+            stack[stackNum++] = 2 * node + 1;
+            stack[stackNum++] = 2 * node;
+            continue;
+        }
+
+        int i, first, last;
+        getLeafRange(index, node - index->leafBase, &first, &last);
+
+        for (i = first; i < last; i++)
+        {
+            int body = index->order[i];
+            Vector3 diff = Vector3Subtract(index->sim->bodies[body]->position, ray.position);
+            float along = Vector3DotProduct(diff, ray.direction);
+
+            if (along <= 0)
+                continue;
+
+            // Tangente del ángulo con el rayo: distancia perpendicular sobre distancia a lo largo
+            Vector3 offset = Vector3Subtract(diff, Vector3Scale(ray.direction, along));
+            float tanSqr = Vector3DotProduct(offset, offset) / (along * along);
+
+            if (tanSqr <= pickedTanSqr)
+            {
+                picked = body;
+                pickedTanSqr = tanSqr;
+            }
+        }
+    }
+
+    if (angle && picked >= 0)
+        *angle = atanf(sqrtf(pickedTanSqr));
+
+    return picked;
+}
+
+void freeSpatialIndex(SpatialIndex *index)
+{
+    free(index->order);
+    free(index->nodes);
+    free(index);
+}
+
+static bool buildSpatialIndex(SpatialIndex *index)
+{
+    int i;
+    OrbitalSim *sim = index->sim;
+    int asteroidNum = sim->bodyNum - sim->bodyNumCore;
+    int leafNum = (asteroidNum + SPATIALINDEX_LEAF_SIZE - 1) / SPATIALINDEX_LEAF_SIZE;
+    int leafBase = 1;
+
+    while (leafBase < leafNum)
+        leafBase *= 2;
+
+    int *order = (int *)malloc((asteroidNum ? asteroidNum : 1) * sizeof(int));
+    int *sortedOrder = (int *)malloc((asteroidNum ? asteroidNum : 1) * sizeof(int));
+    uint32_t *codes = (uint32_t *)malloc((asteroidNum ? asteroidNum : 1) * sizeof(uint32_t));
+    uint32_t *sortedCodes = (uint32_t *)malloc((asteroidNum ? asteroidNum : 1) * sizeof(uint32_t));
+    int *buckets = (int *)malloc((1 << RADIX_BITS) * sizeof(int));
+    SpatialBox *nodes = (SpatialBox *)malloc(2 * leafBase * sizeof(SpatialBox));
+
+    if (!order || !sortedOrder || !codes || !sortedCodes || !buckets || !nodes)
+    {
+        free(order);
+        free(sortedOrder);
+        free(codes);
+        free(sortedCodes);
+        free(buckets);
+        free(nodes);
+        return false;
+    }
+
+    // Caja de todos los asteroides, para cuantizar las posiciones
+    Vector3 min = {FLT_MAX, FLT_MAX, FLT_MAX};
+    Vector3 max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+    for (i = 0; i < asteroidNum; i++)
+    {
+        Vector3 position = sim->bodies[sim->bodyNumCore + i]->position;
+
+        min = Vector3Min(min, position);
+        max = Vector3Max(max, position);
+    }
+
+    Vector3 size = Vector3Subtract(max, min);
+    float scale = (float)((1 << MORTON_BITS) - 1) / fmaxf(fmaxf(size.x, size.y), fmaxf(size.z, FLT_MIN));
+
+    for (i = 0; i < asteroidNum; i++)
+    {
+        Vector3 position = Vector3Scale(Vector3Subtract(sim->bodies[sim->bodyNumCore + i]->position, min), scale);
+
+        order[i] = sim->bodyNumCore + i;
+        codes[i] = (expandMortonBits((uint32_t)position.x) << 2) |
+                   (expandMortonBits((uint32_t)position.y) << 1) |
+                   expandMortonBits((uint32_t)position.z);
+    }
+
+    // Radix sort, estable, de a RADIX_BITS bits
+    for (int shift = 0; shift < 3 * MORTON_BITS; shift += RADIX_BITS)
+    {
+        int sum = 0;
+        uint32_t mask = (1 << RADIX_BITS) - 1;
+
+        memset(buckets, 0, (1 << RADIX_BITS) * sizeof(int));
+
+        for (i = 0; i < asteroidNum; i++)
+            buckets[(codes[i] >> shift) & mask]++;
+
+        for (i = 0; i < (1 << RADIX_BITS); i++)
+        {
+            int count = buckets[i];
+            buckets[i] = sum;
+            sum += count;
+        }
+
+        for (i = 0; i < asteroidNum; i++)
+        {
+            int position = buckets[(codes[i] >> shift) & mask]++;
+
+            sortedCodes[position] = codes[i];
+            sortedOrder[position] = order[i];
+        }
+
+        uint32_t *swapCodes = codes;
+        codes = sortedCodes;
+        sortedCodes = swapCodes;
+
+        int *swapOrder = order;
+        order = sortedOrder;
+        sortedOrder = swapOrder;
+    }
+
+    free(sortedOrder);
+    free(codes);
+    free(sortedCodes);
+    free(buckets);
+
+    free(index->order);
+    free(index->nodes);
+
+    index->order = order;
+    index->nodes = nodes;
+    index->leafNum = leafNum;
+    index->leafBase = leafBase;
+    index->bodyNum = sim->bodyNum;
+    index->builtArea = refitSpatialIndex(index);
+    index->rebuildNum++;
+
+    return true;
+}
+
+static float refitSpatialIndex(SpatialIndex *index)
+{
+    int i, node;
+    double area = 0;
+    const SpatialBox empty = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+
+    for (i = 0; i < index->leafBase; i++)
+    {
+        SpatialBox box = empty;
+
+        if (i < index->leafNum)
+        {
+            int j, first, last;
+            getLeafRange(index, i, &first, &last);
+
+            for (j = first; j < last; j++)
+            {
+                Vector3 position = index->sim->bodies[index->order[j]]->position;
+
+                box.min = Vector3Min(box.min, position);
+                box.max = Vector3Max(box.max, position);
+            }
+        }
+
+        index->nodes[index->leafBase + i] = box;
+    }
+
+    for (node = index->leafBase - 1; node >= 1; node--)
+    {
+        SpatialBox *left = &index->nodes[2 * node];
+        SpatialBox *right = &index->nodes[2 * node + 1];
+        SpatialBox *box = &index->nodes[node];
+
+        box->min = Vector3Min(left->min, right->min);
+        box->max = Vector3Max(left->max, right->max);
+
+        if (!isBoxEmpty(box))
+        {
+            Vector3 size = Vector3Subtract(box->max, box->min);
+            area += 2.0 * ((double)size.x * size.y + (double)size.y * size.z + (double)size.z * size.x);
+        }
+    }
+
+    return (float)area;
+}
+
+static void getLeafRange(SpatialIndex *index, int leaf, int *first, int *last)
+{
+    int asteroidNum = index->bodyNum - index->sim->bodyNumCore;
+
+    *first = leaf * SPATIALINDEX_LEAF_SIZE;
+    *last = *first + SPATIALINDEX_LEAF_SIZE < asteroidNum ? *first + SPATIALINDEX_LEAF_SIZE : asteroidNum;
+}
+
+static uint32_t expandMortonBits(uint32_t value)
+{
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+
+    return value;
+}
+
+static float getBoxDistanceSqr(const SpatialBox *box, Vector3 point)
+{
+    float dx = fmaxf(fmaxf(box->min.x - point.x, point.x - box->max.x), 0);
+    float dy = fmaxf(fmaxf(box->min.y - point.y, point.y - box->max.y), 0);
+    float dz = fmaxf(fmaxf(box->min.z - point.z, point.z - box->max.z), 0);
+
+    return dx * dx + dy * dy + dz * dz;
+}
+
+static bool isBoxHitByRay(const SpatialBox *box, Ray ray, float margin)
+{
+    int axis;
+    float enter = 0;
+    float leave = FLT_MAX;
+
+    const float origin[] = {ray.position.x, ray.position.y, ray.position.z};
+    const float direction[] = {ray.direction.x, ray.direction.y, ray.direction.z};
+    const float min[] = {box->min.x - margin, box->min.y - margin, box->min.z - margin};
+    const float max[] = {box->max.x + margin, box->max.y + margin, box->max.z + margin};
+
+    // Método de las placas (slabs), eje por eje
+    for (axis = 0; axis < 3; axis++)
+    {
+        if (direction[axis] == 0)
+        {
+            if (origin[axis] < min[axis] || origin[axis] > max[axis])
+                return false;
+            continue;
+        }
+
+        float t1 = (min[axis] - origin[axis]) / direction[axis];
+        float t2 = (max[axis] - origin[axis]) / direction[axis];
+
+        enter = fmaxf(enter, fminf(t1, t2));
+        leave = fminf(leave, fmaxf(t1, t2));
+
+        if (enter > leave)
+            return false;
+    }
+
+    return true;
+}
+
+static float getBoxFarthestDistance(const SpatialBox *box, Vector3 point)
+{
+    Vector3 toMin = Vector3Subtract(box->min, point);
+    Vector3 toMax = Vector3Subtract(box->max, point);
+    Vector3 farthest = {fmaxf(fabsf(toMin.x), fabsf(toMax.x)),
+                        fmaxf(fabsf(toMin.y), fabsf(toMax.y)),
+                        fmaxf(fabsf(toMin.z), fabsf(toMax.z))};
+
+    return Vector3Length(farthest);
+}
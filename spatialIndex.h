@@ -0,0 +1,69 @@
+/**
+ * @file spatialIndex.h
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Asteroid spatial index. Consultas de proximidad
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include "orbitalSim.h"
+
+// Asteroides por hoja del árbol
+#define SPATIALINDEX_LEAF_SIZE 8
+
+// Se reconstruye cuando la superficie total de las cajas supera en este factor a la de la última construcción
+#define SPATIALINDEX_REBUILD_RATIO 2.0F
+
+struct SpatialBox
+{
+    Vector3 min;
+    Vector3 max;
+};
+
+struct SpatialIndex
+{
+    OrbitalSim *sim;
+    int bodyNum;        // sim->bodyNum en la última construcción
+    int *order;         // Índices de asteroides en sim->bodies, ordenados por código de Morton
+    int leafNum;
+
+    // Árbol completo: nodes[1] es la raíz, nodes[2n] y nodes[2n+1] los hijos de n, y la hoja i es
+    // nodes[leafBase + i], con leafBase potencia de dos
+    int leafBase;
+    SpatialBox *nodes;
+
+    float builtArea;    // Superficie total de las cajas en la última construcción
+    int rebuildNum;
+};
+
+// Makes a spatial index over the asteroids of a simulation
+SpatialIndex *makeSpatialIndex(OrbitalSim *sim);
+
+// Refits the index to the current asteroid positions, rebuilding it if its quality degraded
+// or the number of bodies changed. Call after each step, before querying. Returns false if
+// the number of bodies changed and it could not be rebuilt: queries then find nothing
+bool updateSpatialIndex(SpatialIndex *index);
+
+// Stores up to maxResults indices (into sim->bodies) of asteroids within radius of center.
+// Returns the number of asteroids found, which may be greater than maxResults
+int findAsteroidsInRadius(SpatialIndex *index, Vector3 center, float radius, int *results, int maxResults);
+
+// Stores the indices (into sim->bodies) of the k asteroids nearest to point, nearest first,
+// and their distances. Returns how many were found (at most k)
+int findNearestAsteroids(SpatialIndex *index, Vector3 point, int k, int *results, float *distances);
+
+// Returns the index (into sim->bodies) of the asteroid seen at the smallest angle from a ray, ahead
+// of its origin and within maxAngle [rad] of it, or -1 if there is none. The tolerance thus grows
+// with the distance, like a pick on screen. Stores that angle if angle is not NULL
+int pickAsteroid(SpatialIndex *index, Ray ray, float maxAngle, float *angle);
+
+// Destroys a given spatial index
+void freeSpatialIndex(SpatialIndex *index);
+
+#endif
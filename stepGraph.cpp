@@ -0,0 +1,181 @@
+/**
+ * @file stepGraph.cpp
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Orbital simulation step graph. Paso de simulación como grafo de tareas
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Sobre el grafo: por cada bloque k de asteroides hay una cadena fuerzas(k) -> integración(k) -> hook(k),
+ *      independiente de los demás bloques, así que el bloque k se integra mientras el k+1 todavía calcula
+ *      fuerzas. La única tarea que espera a todos es la integración de los cuerpos principales, que
+ *      necesita el aporte de cada bloque y, además, no puede moverlos mientras algún bloque los lee.
+ *
+ *          fuerzas principales ------------------------------.
+ *          fuerzas(0) -> integración(0) -> hook(0)           |
+ *              |                                             v
+ *              '---------------------------------> integración principales
+ *          fuerzas(1) -> integración(1) -> hook(1)           ^
+ *              '---------------------------------------------'
+ *
+ *      El tamaño de bloque sale de la cantidad de hilos: con un bloque por hilo, el que termina primero se
+ *      queda sin trabajo, y con bloques muy chicos pesa más el costo de cada tarea. Con varios bloques por
+ *      hilo, el robo de trabajo compensa las diferencias de velocidad entre núcleos.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "stepGraph.h"
+
+/**
+ * @brief Build the task graph, setting the block size for the scheduler threads
+ *
+ * @param step
+ * @param scheduler
+ * @return true on success
+ */
+static bool buildStepGraph(StepGraph *step, TaskScheduler *scheduler);
+
+/**
+ * @brief Get the block size that gives STEPGRAPH_BLOCKS_PER_THREAD blocks to each thread
+ *
+ * @param sim
+ * @param scheduler
+ * @return int
+ */
+static int getStepGraphBlockSize(OrbitalSim *sim, TaskScheduler *scheduler);
+
+// Tareas del grafo: cada una adapta una etapa de updateOrbitalSim a TaskFunction
+
+static void runCoreForces(void *data, int /* index */)
+{
+    computeOrbitalSimCoreForces(((StepGraph *)data)->sim);
+}
+
+static void runBlockForces(void *data, int block)
+{
+    computeOrbitalSimBlockForces(((StepGraph *)data)->sim, block);
+}
+
+static void runBlockIntegration(void *data, int block)
+{
+    integrateOrbitalSimBlock(((StepGraph *)data)->sim, block);
+}
+
+static void runBlockHook(void *data, int block)
+{
+    StepGraph *step = (StepGraph *)data;
+
+    step->hook(step->sim, block, step->hookData);
+}
+
+static void runCoreIntegration(void *data, int /* index */)
+{
+    integrateOrbitalSimCore(((StepGraph *)data)->sim);
+}
+
+StepGraph *makeStepGraph(OrbitalSim *sim, TaskScheduler *scheduler, StepBlockHook hook, void *hookData)
+{
+    StepGraph *step = NULL;
+
+    if (!(step = (StepGraph *)malloc(sizeof(StepGraph))))
+        return NULL;
+
+    *step = {sim, NULL, 0, hook, hookData};
+
+    if (!buildStepGraph(step, scheduler))
+    {
+        free(step);
+        return NULL;
+    }
+
+    return step;
+}
+
+void updateOrbitalSimGraph(StepGraph *step, TaskScheduler *scheduler)
+{
+    OrbitalSim *sim = step->sim;
+
+    // Cambió la cantidad de asteroides (por ejemplo, al cargar un catálogo) o de hilos
+    if ((sim->blockSize != getStepGraphBlockSize(sim, scheduler) || step->blockNum != getOrbitalSimBlockNum(sim)) &&
+        !buildStepGraph(step, scheduler))
+        return;
+
+    if (!reserveOrbitalSimBlocks(sim))
+        return;
+
+    runTaskGraph(scheduler, step->graph);
+}
+
+void freeStepGraph(StepGraph *step)
+{
+    if (step->graph)
+        freeTaskGraph(step->graph);
+
+    free(step);
+}
+
+static bool buildStepGraph(StepGraph *step, TaskScheduler *scheduler)
+{
+    int block;
+    OrbitalSim *sim = step->sim;
+    int blockSize = sim->blockSize;
+
+    sim->blockSize = getStepGraphBlockSize(sim, scheduler);
+
+    int blockNum = getOrbitalSimBlockNum(sim);
+    TaskGraph *graph = makeTaskGraph();
+
+    if (!graph)
+    {
+        sim->blockSize = blockSize;
+        return false;
+    }
+
+    int coreForces = addTask(graph, runCoreForces, step, 0);
+    int coreIntegration = addTask(graph, runCoreIntegration, step, 0);
+    bool success = coreForces >= 0 && coreIntegration >= 0 &&
+                   addTaskDependency(graph, coreIntegration, coreForces);
+
+    for (block = 0; success && block < blockNum; block++)
+    {
+        int blockForces = addTask(graph, runBlockForces, step, block);
+        int blockIntegration = addTask(graph, runBlockIntegration, step, block);
+
+        success = blockForces >= 0 && blockIntegration >= 0 &&
+                  addTaskDependency(graph, blockIntegration, blockForces) &&
+                  addTaskDependency(graph, coreIntegration, blockForces);
+
+        if (success && step->hook)
+        {
+            int blockHook = addTask(graph, runBlockHook, step, block);
+
+            success = blockHook >= 0 && addTaskDependency(graph, blockHook, blockIntegration);
+        }
+    }
+
+    if (!success)
+    {
+        freeTaskGraph(graph);
+        sim->blockSize = blockSize;
+        return false;
+    }
+
+    if (step->graph)
+        freeTaskGraph(step->graph);
+
+    step->graph = graph;
+    step->blockNum = blockNum;
+
+    return true;
+}
+
+static int getStepGraphBlockSize(OrbitalSim *sim, TaskScheduler *scheduler)
+{
+    int blockNum = getTaskSchedulerThreadNum(scheduler) * STEPGRAPH_BLOCKS_PER_THREAD;
+    int blockSize = (sim->bodyNum - sim->bodyNumCore + blockNum - 1) / blockNum;
+
+    return blockSize > ORBITALSIM_BLOCK_SIZE_MIN ? blockSize : ORBITALSIM_BLOCK_SIZE_MIN;
+}
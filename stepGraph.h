@@ -0,0 +1,45 @@
+/**
+ * @file stepGraph.h
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Orbital simulation step graph. Paso de simulación como grafo de tareas
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef STEPGRAPH_H
+#define STEPGRAPH_H
+
+#include "orbitalSim.h"
+#include "taskScheduler.h"
+
+// Bloques de asteroides por hilo del planificador, para que el robo de trabajo pueda emparejar la carga
+#define STEPGRAPH_BLOCKS_PER_THREAD 4
+
+// Etapa extra por bloque de asteroides (diagnóstico, captura, etc.), que corre apenas se integra el bloque.
+// Sólo puede leer ese bloque: los cuerpos principales y otros bloques pueden estar actualizándose
+typedef void (*StepBlockHook)(OrbitalSim *sim, int block, void *data);
+
+struct StepGraph
+{
+    OrbitalSim *sim;
+    TaskGraph *graph;
+    int blockNum; // Bloques para los que se armó graph, de sim->blockSize asteroides
+    StepBlockHook hook;
+    void *hookData;
+};
+
+// Makes the task graph of a simulation step, setting sim->blockSize so that each scheduler thread
+// gets STEPGRAPH_BLOCKS_PER_THREAD blocks. hook may be NULL
+StepGraph *makeStepGraph(OrbitalSim *sim, TaskScheduler *scheduler, StepBlockHook hook, void *hookData);
+
+// Simulates a timestep running the step graph on a scheduler. Same result as updateOrbitalSim
+// with the same sim->blockSize. If out of memory, the step is skipped
+void updateOrbitalSimGraph(StepGraph *step, TaskScheduler *scheduler);
+
+// Destroys a given step graph
+void freeStepGraph(StepGraph *step);
+
+#endif
@@ -0,0 +1,337 @@
+/**
+ * @file taskScheduler.cpp
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Task scheduler. Grafo de tareas con robo de trabajo
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Sobre el funcionamiento: cada hilo tiene su propia cola de tareas listas. Al terminar una tarea, se
+ *      descuenta una dependencia de cada sucesora, y las que quedan sin dependencias se encolan en el hilo
+ *      que las liberó, que las toma primero (LIFO), aprovechando que los datos siguen en su caché. Un hilo
+ *      sin trabajo le roba a otro la tarea más vieja de su cola (FIFO). Así no hay barreras globales: una
+ *      tarea empieza apenas terminan las suyas, aunque otras partes del grafo sigan calculándose.
+ *
+ *      El hilo que llama a runTaskGraph trabaja como uno más (el 0) hasta que se completa el grafo. Los
+ *      demás duermen cuando no hay tareas encoladas.
+ *
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "taskScheduler.h"
+
+struct Task
+{
+    TaskFunction function;
+    void *data;
+    int index;
+    int dependencyNum;
+    std::vector<int> successors;
+};
+
+struct TaskGraph
+{
+    std::vector<Task> tasks;
+    std::unique_ptr<std::atomic<int>[]> pending; // Dependencias sin terminar, durante una corrida
+    int pendingNum;
+};
+
+struct TaskWorker
+{
+    std::mutex mutex;
+    std::deque<int> queue;
+};
+
+struct TaskScheduler
+{
+    int threadNum;
+    std::unique_ptr<TaskWorker[]> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<int> queuedNum;
+    bool stop; // Protegido por sleepMutex
+
+    TaskGraph *graph;
+    std::atomic<int> remainingNum;
+};
+
+/**
+ * @brief Loop of each scheduler thread but the caller
+ *
+ * @param scheduler
+ * @param worker
+ */
+static void runTaskWorker(TaskScheduler *scheduler, int worker);
+
+/**
+ * @brief Take a ready task: from the worker queue first, stealing otherwise
+ *
+ * @param scheduler
+ * @param worker
+ * @param task
+ * @return true if a task was taken
+ */
+static bool takeTask(TaskScheduler *scheduler, int worker, int *task);
+
+/**
+ * @brief Queue a ready task in a worker and wake up a sleeping thread
+ *
+ * @param scheduler
+ * @param worker
+ * @param task
+ */
+static void pushTask(TaskScheduler *scheduler, int worker, int task);
+
+/**
+ * @brief Run a task and release its successors
+ *
+ * @param scheduler
+ * @param worker
+ * @param task
+ */
+static void executeTask(TaskScheduler *scheduler, int worker, int task);
+
+TaskGraph *makeTaskGraph()
+{
+    TaskGraph *graph = new (std::nothrow) TaskGraph;
+
+    if (graph)
+        graph->pendingNum = 0;
+
+    return graph;
+}
+
+int addTask(TaskGraph *graph, TaskFunction function, void *data, int index)
+{
+    try
+    {
+        graph->tasks.push_back({function, data, index, 0, std::vector<int>()});
+    }
+    catch (const std::bad_alloc &)
+    {
+        return -1;
+    }
+
+    return (int)graph->tasks.size() - 1;
+}
+
+bool addTaskDependency(TaskGraph *graph, int task, int dependency)
+{
+    try
+    {
+        graph->tasks[dependency].successors.push_back(task);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return false;
+    }
+
+    graph->tasks[task].dependencyNum++;
+
+    return true;
+}
+
+void freeTaskGraph(TaskGraph *graph)
+{
+    delete graph;
+}
+
+TaskScheduler *makeTaskScheduler(int threadNum)
+{
+    int i;
+
+    if (threadNum <= 0)
+        threadNum = (int)std::thread::hardware_concurrency();
+    if (threadNum <= 0)
+        threadNum = 1;
+
+    TaskScheduler *scheduler = new (std::nothrow) TaskScheduler;
+
+    if (!scheduler)
+        return NULL;
+
+    scheduler->threadNum = threadNum;
+    scheduler->queuedNum = 0;
+    scheduler->stop = false;
+    scheduler->graph = NULL;
+    scheduler->remainingNum = 0;
+
+    try
+    {
+        scheduler->workers.reset(new TaskWorker[threadNum]);
+
+        for (i = 1; i < threadNum; i++)
+            scheduler->threads.emplace_back(runTaskWorker, scheduler, i);
+    }
+    catch (...)
+    {
+        freeTaskScheduler(scheduler);
+        return NULL;
+    }
+
+    return scheduler;
+}
+
+int getTaskSchedulerThreadNum(TaskScheduler *scheduler)
+{
+    return scheduler->threadNum;
+}
+
+bool runTaskGraph(TaskScheduler *scheduler, TaskGraph *graph)
+{
+    int i, task;
+    int taskNum = (int)graph->tasks.size();
+    int rootNum = 0;
+
+    if (!taskNum)
+        return true;
+
+    if (graph->pendingNum != taskNum)
+    {
+        std::atomic<int> *pending = new (std::nothrow) std::atomic<int>[taskNum];
+
+        if (!pending)
+            return false;
+
+        graph->pending.reset(pending);
+        graph->pendingNum = taskNum;
+    }
+
+    for (i = 0; i < taskNum; i++)
+        graph->pending[i].store(graph->tasks[i].dependencyNum, std::memory_order_relaxed);
+
+    scheduler->remainingNum.store(taskNum, std::memory_order_relaxed);
+    scheduler->graph = graph;
+
+    // Las tareas sin dependencias se reparten entre todos los hilos
+    for (i = 0; i < taskNum; i++)
+    {
+        if (!graph->tasks[i].dependencyNum)
+            pushTask(scheduler, rootNum++ % scheduler->threadNum, i);
+    }
+
+    while (scheduler->remainingNum.load(std::memory_order_acquire) > 0)
+    {
+        if (takeTask(scheduler, 0, &task))
+            executeTask(scheduler, 0, task);
+        else
+            std::this_thread::yield();
+    }
+
+    scheduler->graph = NULL;
+
+    return true;
+}
+
+void freeTaskScheduler(TaskScheduler *scheduler)
+{
+    {
+        std::lock_guard<std::mutex> lock(scheduler->sleepMutex);
+        scheduler->stop = true;
+    }
+    scheduler->wakeUp.notify_all();
+
+    for (std::thread &thread : scheduler->threads)
+        thread.join();
+
+    delete scheduler;
+}
+
+static void runTaskWorker(TaskScheduler *scheduler, int worker)
+{
+    int task;
+
+    while (true)
+    {
+        if (takeTask(scheduler, worker, &task))
+        {
+            executeTask(scheduler, worker, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(scheduler->sleepMutex);
+        scheduler->wakeUp.wait(lock, [scheduler]
+                               { return scheduler->stop || scheduler->queuedNum.load() > 0; });
+
+        if (scheduler->stop)
+            return;
+    }
+}
+
+static bool takeTask(TaskScheduler *scheduler, int worker, int *task)
+{
+    int i;
+
+    {
+        TaskWorker &own = scheduler->workers[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.queue.empty())
+        {
+            *task = own.queue.back();
+            own.queue.pop_back();
+            scheduler->queuedNum--;
+            return true;
+        }
+    }
+
+    for (i = 1; i < scheduler->threadNum; i++)
+    {
+        TaskWorker &victim = scheduler->workers[(worker + i) % scheduler->threadNum];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.queue.empty())
+        {
+            *task = victim.queue.front();
+            victim.queue.pop_front();
+            scheduler->queuedNum--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void pushTask(TaskScheduler *scheduler, int worker, int task)
+{
+    {
+        TaskWorker &own = scheduler->workers[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.queue.push_back(task);
+    }
+
+    scheduler->queuedNum++;
+
+    // Tomar sleepMutex evita despertar a un hilo justo antes de que se duerma
+    {
+        std::lock_guard<std::mutex> lock(scheduler->sleepMutex);
+    }
+    scheduler->wakeUp.notify_one();
+}
+
+static void executeTask(TaskScheduler *scheduler, int worker, int task)
+{
+    TaskGraph *graph = scheduler->graph;
+    Task &current = graph->tasks[task];
+
+    current.function(current.data, current.index);
+
+    for (int successor : current.successors)
+    {
+        if (graph->pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            pushTask(scheduler, worker, successor);
+    }
+
+    scheduler->remainingNum.fetch_sub(1, std::memory_order_acq_rel);
+}
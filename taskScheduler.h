@@ -0,0 +1,46 @@
+/**
+ * @file taskScheduler.h
+ * @authors Marc Ressl - Alejandro Heir, Matías Álvarez
+ * @brief Task scheduler. Grafo de tareas con robo de trabajo
+ * @version 0.1
+ * @date 2022-03-09
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+// Tarea: función, datos compartidos e índice propio (por ejemplo, un bloque de asteroides)
+typedef void (*TaskFunction)(void *data, int index);
+
+struct TaskGraph;
+struct TaskScheduler;
+
+// Makes an empty task graph. A graph can be run any number of times
+TaskGraph *makeTaskGraph();
+
+// Adds a task to a graph. Returns its id, or -1 if out of memory
+int addTask(TaskGraph *graph, TaskFunction function, void *data, int index);
+
+// Makes task wait for dependency. Returns false if out of memory
+bool addTaskDependency(TaskGraph *graph, int task, int dependency);
+
+// Destroys a given task graph
+void freeTaskGraph(TaskGraph *graph);
+
+// Makes a scheduler with threadNum threads, counting the caller. 0 uses all cores
+TaskScheduler *makeTaskScheduler(int threadNum);
+
+// Number of threads of a scheduler, counting the caller
+int getTaskSchedulerThreadNum(TaskScheduler *scheduler);
+
+// Runs every task of a graph, respecting dependencies. Returns when all are done, or false
+// without running any if out of memory
+bool runTaskGraph(TaskScheduler *scheduler, TaskGraph *graph);
+
+// Destroys a given scheduler
+void freeTaskScheduler(TaskScheduler *scheduler);
+
+#endif